@@ -0,0 +1,539 @@
+#include "Benchmark.h"
+#include "WeatherData.h"
+#include "MetDataParser.h"
+#include "StatKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    double secondsSince(Clock::time_point start) {
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        return elapsed.count();
+    }
+
+    // The row parser as it was before the memory-mapped loader, kept as the
+    // reference point: getline, stringstream split, substr + stringstream date, stod.
+    bool legacyParseLine(const std::string& line, WeatherRecord& record) {
+        std::stringstream ss(line);
+        std::string token;
+        std::vector<std::string> tokens;
+
+        while (std::getline(ss, token, ',')) {
+            tokens.push_back(token);
+        }
+        if (tokens.size() < 18) {
+            return false;
+        }
+
+        std::string datePart = tokens[0].substr(0, tokens[0].find(' '));
+        std::stringstream dateStream(datePart);
+        int day, month, year;
+        char slash1, slash2;
+        dateStream >> day >> slash1 >> month >> slash2 >> year;
+
+        record.timestamp = Date(day, month, year);
+        record.windSpeed = std::stod(tokens[10]);
+        record.solarRadiation = std::stod(tokens[11]);
+        record.temperature = std::stod(tokens[17]);
+        return true;
+    }
+
+    long long legacyParseFile(const std::string& filename, std::size_t& bytes) {
+        std::ifstream dataFile(filename);
+        if (!dataFile.is_open()) {
+            return 0;
+        }
+
+        WeatherRecord record(DateTime(), 0.0, 0.0, 0.0);
+        std::string line;
+        bool firstLine = true;
+        long long rows = 0;
+
+        while (std::getline(dataFile, line)) {
+            bytes += line.size() + 1;
+            if (line.empty()) continue;
+            if (firstLine) {
+                if (MetDataParser::isHeaderLine(line)) firstLine = false;
+                continue;
+            }
+            if (legacyParseLine(line, record)) rows++;
+        }
+        return rows;
+    }
+
+    // The tree as it was before balancing, for comparison. Insert is written
+    // iteratively so that a degenerate tree does not overflow the stack here.
+    template <class T>
+    class PlainBst {
+    private:
+        struct Node {
+            T value;
+            Node* left;
+            Node* right;
+        };
+
+        Node* root;
+        int maxDepth;
+
+    public:
+        PlainBst() : root(nullptr), maxDepth(-1) {}
+        PlainBst(const PlainBst&) = delete;
+        PlainBst& operator=(const PlainBst&) = delete;
+        ~PlainBst() {
+            // Unlink iteratively for the same reason
+            while (root != nullptr) {
+                if (root->left != nullptr) {
+                    Node* child = root->left;
+                    root->left = child->right;
+                    child->right = root;
+                    root = child;
+                } else {
+                    Node* next = root->right;
+                    delete root;
+                    root = next;
+                }
+            }
+        }
+
+        void insert(const T& value) {
+            Node** link = &root;
+            int depth = 0;
+            while (*link != nullptr) {
+                if (value < (*link)->value) link = &(*link)->left;
+                else if ((*link)->value < value) link = &(*link)->right;
+                else return;
+                depth++;
+            }
+            *link = new Node{value, nullptr, nullptr};
+            maxDepth = std::max(maxDepth, depth);
+        }
+
+        int height() const { return maxDepth; }
+    };
+
+    const char* const ARCHIVE_HEADER = "WAST,DP,Dta,Dts,EV,QFE,QFF,QNH,RF,RH,S,SR,T,ST1,ST2,ST3,ST4,Sx";
+    const int ARCHIVE_FIRST_YEAR = 2000;
+
+    // Keys of a chronological load of rows readings, 10 minutes apart
+    std::vector<RecordIndex> chronologicalKeys(long long rows) {
+        std::int64_t first = DateTime(Date(1, 1, ARCHIVE_FIRST_YEAR)).GetMinutesSinceEpoch();
+        std::vector<RecordIndex> keys;
+        keys.reserve(static_cast<std::size_t>(rows));
+        for (long long row = 0; row < rows; row++) {
+            keys.emplace_back(DateTime::fromMinutes(first + row * 10), static_cast<std::uint32_t>(row));
+        }
+        return keys;
+    }
+
+    // Insert every key, then look up each probe once. Prints ns per operation.
+    template <class MapType>
+    void timeMap(const char* name, const std::vector<int>& keys, const std::vector<int>& probes) {
+        Clock::time_point start = Clock::now();
+        MapType map;
+        for (int key : keys) {
+            map.findOrInsert(key) += key;
+        }
+        double insertSeconds = secondsSince(start);
+
+        start = Clock::now();
+        long long found = 0;
+        for (int probe : probes) {
+            const int* value = map.find(probe);
+            if (value != nullptr) found += *value;
+        }
+        double lookupSeconds = secondsSince(start);
+
+        std::cout << "  " << name << ": insert " << insertSeconds * 1e9 / keys.size() << " ns, lookup "
+                  << lookupSeconds * 1e9 / probes.size() << " ns (checksum " << found << ")" << std::endl;
+    }
+}
+
+namespace Benchmark
+{
+    void runLoaderBenchmark(const std::string& dataSourceFile)
+    {
+        std::vector<std::string> filenames;
+        if (!MetDataParser::readSourceList(dataSourceFile, filenames)) {
+            std::cerr << "Error: Could not open data source file: " << dataSourceFile << std::endl;
+            return;
+        }
+
+        std::cout << "\n--- Loader throughput (parse only, " << filenames.size() << " file(s)) ---" << std::endl;
+
+        try {
+            std::size_t bytes = 0;
+            long long rows = 0;
+            Clock::time_point start = Clock::now();
+            for (const std::string& filename : filenames) {
+                rows += legacyParseFile(filename, bytes);
+            }
+            std::cout << "getline + stringstream: ";
+            reportThroughput(std::cout, static_cast<int>(filenames.size()), rows, bytes, secondsSince(start));
+
+            unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned threads : {1u, hardwareThreads}) {
+                std::vector<RecordBatch> batches;
+                start = Clock::now();
+                parseFilesConcurrently(filenames, batches, threads);
+                double seconds = secondsSince(start);
+
+                bytes = 0;
+                rows = 0;
+                for (const RecordBatch& batch : batches) {
+                    bytes += batch.bytes;
+                    rows += batch.rows;
+                }
+                std::cout << "mmap + from_chars, " << threads << " thread(s): ";
+                reportThroughput(std::cout, static_cast<int>(filenames.size()), rows, bytes, seconds);
+                if (threads == hardwareThreads) break;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Benchmark aborted: " << e.what() << std::endl;
+        }
+    }
+
+    std::string writeSyntheticArchive(const std::string& directory, long long rows)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string sourceFile = (std::filesystem::path(directory) / "data_source.txt").string();
+        std::ofstream sources(sourceFile, std::ios::trunc);
+        if (!sources.is_open()) {
+            std::cerr << "Error: Could not create " << sourceFile << std::endl;
+            return std::string();
+        }
+
+        std::int64_t first = DateTime(Date(1, 1, ARCHIVE_FIRST_YEAR)).GetMinutesSinceEpoch();
+        std::ofstream data;
+        int fileYear = 0;
+        unsigned seed = 283;
+        char line[256];
+        for (long long row = 0; row < rows; row++) {
+            DateTime timestamp = DateTime::fromMinutes(first + row * 10);
+            if (timestamp.GetYear() != fileYear) {
+                // One file per year, as the weather station exports them
+                fileYear = timestamp.GetYear();
+                std::string filename =
+                    (std::filesystem::path(directory) / ("MetData_" + std::to_string(fileYear) + ".csv")).string();
+                data.close();
+                data.open(filename, std::ios::binary | std::ios::trunc);
+                if (!data.is_open()) {
+                    std::cerr << "Error: Could not create " << filename << std::endl;
+                    return std::string();
+                }
+                data << ARCHIVE_HEADER << '\n';
+                sources << filename << '\n';
+            }
+
+            // Seasonal values with noise, in the units of the real files
+            int month = timestamp.GetMonth();
+            seed = seed * 1103515245u + 12345u;
+            int windSpeed = static_cast<int>((seed >> 16) % 40);
+            seed = seed * 1103515245u + 12345u;
+            double temperature = 10.0 + std::abs(month - 7) * 2.5 + (seed >> 16) % 1500 / 100.0;
+            int minuteOfDay = timestamp.GetHour() * 60 + timestamp.GetMinute();
+            int solarRadiation = (minuteOfDay > 360 && minuteOfDay < 1140) ? static_cast<int>((seed >> 8) % 1100) : 1;
+
+            char* end = timestamp.format(line, line + sizeof(line));
+            std::snprintf(end, line + sizeof(line) - end,
+                          ",12.2,221,34,0,1013.4,1016.9,1017,0,68.2,%d,%d,%.2f,22.7,24.1,25.5,26.1,8\n", windSpeed,
+                          solarRadiation, temperature);
+            data << line;
+        }
+        data.close();
+        if (data.fail() || !sources.good()) {
+            std::cerr << "Error: Could not write the benchmark archive under " << directory << std::endl;
+            return std::string();
+        }
+        return sourceFile;
+    }
+
+    void runCollectionBenchmark(const std::string& dataSourceFile, const std::string& workDirectory,
+                                bool outOfCore)
+    {
+        std::cout << "\n--- WeatherDataCollection " << (outOfCore ? "with a segment store" : "in memory")
+                  << ": load and monthly reports ---" << std::endl;
+
+        WeatherDataCollection collection;
+        collection.setSnapshotEnabled(false);
+        if (outOfCore) {
+            std::string storeDirectory = (std::filesystem::path(workDirectory) / "segments").string();
+            std::error_code error;
+            std::filesystem::remove_all(storeDirectory, error);
+            if (!collection.openSegmentStore(storeDirectory, std::size_t(256) << 20)) {
+                return;
+            }
+        }
+
+        Clock::time_point start = Clock::now();
+        collection.loadFromFiles(dataSourceFile);
+        double loadSeconds = secondsSince(start);
+        long long rows = collection.getTotalRecords();
+
+        std::vector<int> years = collection.getAvailableYears();
+        start = Clock::now();
+        for (int year : years) {
+            std::string filename =
+                (std::filesystem::path(workDirectory) / ("WindTempSolar_" + std::to_string(year) + ".csv")).string();
+            collection.generateMonthlyStats(year, filename);
+        }
+        double reportSeconds = secondsSince(start);
+
+        std::cout << "loadFromFiles: " << rows << " rows in " << loadSeconds << " s ("
+                  << (loadSeconds > 0.0 ? rows / loadSeconds : 0.0) << " rows/s)" << std::endl;
+        std::cout << "generateMonthlyStats: " << years.size() << " year(s) in " << reportSeconds * 1000.0 << " ms ("
+                  << (years.empty() ? 0.0 : reportSeconds * 1000.0 / years.size()) << " ms per year)" << std::endl;
+    }
+
+    void runBstBenchmark(long long rows)
+    {
+        std::cout << "\n--- Bst<RecordIndex> on a chronological load ---" << std::endl;
+
+        std::vector<RecordIndex> keys = chronologicalKeys(rows);
+        Clock::time_point start = Clock::now();
+        Bst<RecordIndex> tree;
+        for (const RecordIndex& key : keys) {
+            tree.insert(key);
+        }
+        double insertSeconds = secondsSince(start);
+        std::cout << keys.size() << " keys one at a time: height " << tree.height() << ", "
+                  << insertSeconds * 1000.0 << " ms, " << tree.allocationCount() << " node blocks"
+                  << (tree.checkInvariant() ? "" : " [INVARIANT BROKEN]") << std::endl;
+
+        start = Clock::now();
+        Bst<RecordIndex> bulk;
+        bulk.insertSorted(keys.begin(), keys.end());
+        std::cout << keys.size() << " keys bulk-loaded: height " << bulk.height() << ", "
+                  << secondsSince(start) * 1000.0 << " ms" << std::endl;
+
+        start = Clock::now();
+        Bst<RecordIndex> copy(tree);
+        double copySeconds = secondsSince(start);
+        start = Clock::now();
+        copy.clear();
+        std::cout << "copy: " << copySeconds * 1000.0 << " ms, destroy: " << secondsSince(start) * 1000.0 << " ms"
+                  << std::endl;
+
+        // The unbalanced tree degenerates into a list on sorted keys, so its
+        // total insert time grows with n^2; it is only run where that is short
+        for (std::size_t n : {std::size_t(10000), std::size_t(20000), std::size_t(40000)}) {
+            if (n > keys.size()) break;
+            start = Clock::now();
+            Bst<RecordIndex> balanced;
+            for (std::size_t i = 0; i < n; i++) balanced.insert(keys[i]);
+            double balancedSeconds = secondsSince(start);
+
+            start = Clock::now();
+            PlainBst<RecordIndex> plain;
+            for (std::size_t i = 0; i < n; i++) plain.insert(keys[i]);
+            std::cout << n << " keys: AVL height " << balanced.height() << ", " << balancedSeconds * 1000.0
+                      << " ms | unbalanced height " << plain.height() << ", " << secondsSince(start) * 1000.0
+                      << " ms" << std::endl;
+        }
+    }
+
+    void runMapBenchmark()
+    {
+        std::cout << "\n--- Map backends (int keys) ---" << std::endl;
+
+        // Months: 12 dense keys, looked up once per loaded record
+        std::vector<int> months;
+        for (int month = 1; month <= 12; month++) months.push_back(month);
+        std::vector<int> monthProbes(2000000);
+        unsigned seed = 12345;
+        for (int& probe : monthProbes) {
+            seed = seed * 1103515245u + 12345u;
+            probe = static_cast<int>((seed >> 16) % 12) + 1;
+        }
+
+        std::cout << "12 month keys, " << monthProbes.size() << " lookups:" << std::endl;
+        timeMap<Map<int, int>>("tree (std::map)", months, monthProbes);
+        timeMap<Map<int, int, FlatBackend<int, int>>>("sorted vector  ", months, monthProbes);
+        timeMap<Map<int, int, HashBackend<int, int>>>("open addressing", months, monthProbes);
+        timeMap<MonthMap<int>>("direct array   ", months, monthProbes);
+
+        // Sparse keys in random order, half of the lookups miss
+        std::vector<int> keys(100000);
+        for (int& key : keys) {
+            seed = seed * 1103515245u + 12345u;
+            key = static_cast<int>(seed >> 1);
+        }
+        std::vector<int> probes(1000000);
+        for (std::size_t i = 0; i < probes.size(); i++) {
+            seed = seed * 1103515245u + 12345u;
+            probes[i] = (i % 2 == 0) ? keys[(seed >> 8) % keys.size()] : static_cast<int>(seed >> 1);
+        }
+
+        std::cout << keys.size() << " random keys, " << probes.size() << " lookups:" << std::endl;
+        timeMap<Map<int, int>>("tree (std::map)", keys, probes);
+        timeMap<Map<int, int, FlatBackend<int, int>>>("sorted vector  ", keys, probes);
+        timeMap<Map<int, int, HashBackend<int, int>>>("open addressing", keys, probes);
+    }
+
+    void runKernelBenchmark()
+    {
+        // Large enough to stream from memory rather than cache
+        const std::size_t n = 1 << 22;
+        const int repeats = 5;
+
+        std::vector<double> x(n), y(n);
+        unsigned seed = 2024;
+        for (std::size_t i = 0; i < n; i++) {
+            seed = seed * 1103515245u + 12345u;
+            x[i] = (seed >> 8) % 4000 / 100.0; // wind speed like, 0-40
+            seed = seed * 1103515245u + 12345u;
+            y[i] = (seed >> 8) % 5000 / 100.0 - 5.0; // temperature like, -5-45
+        }
+        const double mean = 20.0;
+
+        std::cout << "\n--- Statistics kernels (" << n << " doubles, best of " << repeats << ") ---" << std::endl;
+
+        // Time one kernel: best of the repeats, reported as GB/s of input read
+        auto timeKernel = [&](const char* name, std::size_t bytes, double reference, auto kernel) {
+            double best = 0.0, result = 0.0;
+            for (int r = 0; r < repeats; r++) {
+                Clock::time_point start = Clock::now();
+                result = kernel();
+                double seconds = secondsSince(start);
+                if (r == 0 || seconds < best) best = seconds;
+            }
+            double difference = (reference == 0.0) ? 0.0 : std::abs(result - reference) / std::abs(reference);
+            std::cout << "  " << name << ": " << bytes / best / 1e9 << " GB/s"
+                      << " (relative difference from scalar " << difference << ")" << std::endl;
+            return result;
+        };
+
+        StatKernels::IsaLevel original = StatKernels::getIsaLevel();
+        StatKernels::IsaLevel best = StatKernels::detectIsaLevel();
+        double references[4] = {0.0, 0.0, 0.0, 0.0};
+
+        for (int level = 0; level <= static_cast<int>(best); level++) {
+            StatKernels::setIsaLevel(static_cast<StatKernels::IsaLevel>(level));
+            std::cout << StatKernels::isaName(StatKernels::getIsaLevel()) << ":" << std::endl;
+
+            double results[4];
+            results[0] = timeKernel("sum                   ", n * sizeof(double), references[0],
+                                    [&] { return StatKernels::sum(x.data(), n); });
+            results[1] = timeKernel("sum of squared devs   ", n * sizeof(double), references[1],
+                                    [&] { return StatKernels::sumSquaredDeviations(x.data(), n, mean); });
+            results[2] = timeKernel("sum of absolute devs  ", n * sizeof(double), references[2],
+                                    [&] { return StatKernels::sumAbsDeviations(x.data(), n, mean); });
+            results[3] = timeKernel("centered pair sums    ", 2 * n * sizeof(double), references[3], [&] {
+                return StatKernels::centeredPairSums(x.data(), y.data(), n, mean, mean).sumDXDY;
+            });
+
+            if (level == 0) {
+                for (int k = 0; k < 4; k++) references[k] = results[k];
+            }
+        }
+
+        StatKernels::setIsaLevel(original);
+    }
+
+    void runQuantileBenchmark()
+    {
+        // 20 years of 10-minute readings, one partition per (year, month)
+        const std::size_t partitionCount = 240;
+        const std::size_t rowsPerPartition = 4464;
+        const double fractions[] = {0.05, 0.5, 0.95};
+
+        std::vector<std::vector<double>> partitions(partitionCount);
+        std::vector<Statistics::QuantileSketch> sketches(partitionCount);
+        unsigned seed = 2024;
+        Clock::time_point start = Clock::now();
+        for (std::size_t p = 0; p < partitionCount; p++) {
+            partitions[p].resize(rowsPerPartition);
+            for (double& value : partitions[p]) {
+                seed = seed * 1103515245u + 12345u;
+                value = (seed >> 8) % 4000 / 100.0 + p % 12; // wind speed like, varying by month
+                sketches[p].add(value);
+            }
+        }
+        double buildSeconds = secondsSince(start);
+
+        std::size_t total = partitionCount * rowsPerPartition;
+        std::cout << "\n--- Percentiles over " << partitionCount << " partitions, " << total << " values ---"
+                  << std::endl;
+        std::cout << "Generating values and filling the sketches: " << buildSeconds * 1000 << " ms" << std::endl;
+
+        // Exact: copy every value and select the ranks
+        start = Clock::now();
+        std::vector<double> values;
+        values.reserve(total);
+        for (const std::vector<double>& partition : partitions) {
+            values.insert(values.end(), partition.begin(), partition.end());
+        }
+        double exact[3];
+        for (int q = 0; q < 3; q++) {
+            std::size_t rank = static_cast<std::size_t>(fractions[q] * (total - 1));
+            std::nth_element(values.begin(), values.begin() + rank, values.end());
+            exact[q] = values[rank];
+        }
+        double exactSeconds = secondsSince(start);
+
+        // Sketch: merge the partitions' sketches and query the result
+        start = Clock::now();
+        Statistics::QuantileSketch merged;
+        for (const Statistics::QuantileSketch& sketch : sketches) {
+            merged.merge(sketch);
+        }
+        double approximate[3];
+        for (int q = 0; q < 3; q++) {
+            approximate[q] = merged.quantile(fractions[q]);
+        }
+        double sketchSeconds = secondsSince(start);
+
+        std::cout << "Exact (copy + nth_element): " << exactSeconds * 1000 << " ms, "
+                  << total * sizeof(double) / 1024 << " KB copied" << std::endl;
+        std::cout << "Sketch (merge + query):     " << sketchSeconds * 1000 << " ms, "
+                  << merged.getRetainedCount() * sizeof(double) / 1024 << " KB retained" << std::endl;
+
+        std::sort(values.begin(), values.end());
+        for (int q = 0; q < 3; q++) {
+            double lower = std::lower_bound(values.begin(), values.end(), approximate[q]) - values.begin();
+            double upper = std::upper_bound(values.begin(), values.end(), approximate[q]) - values.begin();
+            double wanted = fractions[q] * total;
+            double rankError = (wanted < lower) ? lower - wanted : (wanted > upper ? wanted - upper : 0.0);
+            std::cout << "  p" << fractions[q] * 100 << ": exact " << exact[q] << ", sketch " << approximate[q]
+                      << " (rank error " << rankError / total * 100 << "%, bound "
+                      << merged.getRankError() * 100 << "%)" << std::endl;
+        }
+    }
+
+    bool runAll(long long rows)
+    {
+        std::string workDirectory = (std::filesystem::temp_directory_path() / "ict283-benchmark").string();
+        std::error_code error;
+        std::filesystem::remove_all(workDirectory, error);
+
+        std::cout << "\nWriting " << rows << " generated readings under " << workDirectory << "..." << std::endl;
+        Clock::time_point start = Clock::now();
+        std::string dataSourceFile = writeSyntheticArchive(workDirectory, rows);
+        if (dataSourceFile.empty()) {
+            return false;
+        }
+        std::cout << "Written in " << secondsSince(start) << " s" << std::endl;
+
+        runLoaderBenchmark(dataSourceFile);
+        runCollectionBenchmark(dataSourceFile, workDirectory, false);
+        runCollectionBenchmark(dataSourceFile, workDirectory, true);
+        runBstBenchmark(rows);
+        runMapBenchmark();
+        runKernelBenchmark();
+        runQuantileBenchmark();
+
+        std::filesystem::remove_all(workDirectory, error);
+        return true;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+/// Performance benchmarks, run with the --benchmark command-line option.
+/// Results are printed to std::cout.
+namespace Benchmark
+{
+    /// Write rows readings 10 minutes apart from 1/1/2000, one MetData file
+    /// per year, and a data source file listing them, under directory.
+    /// @return the data source file, or an empty string if writing failed
+    std::string writeSyntheticArchive(const std::string& directory, long long rows);
+
+    /// Compare the original getline/stringstream loader against the
+    /// memory-mapped scanner on the files listed in dataSourceFile.
+    void runLoaderBenchmark(const std::string& dataSourceFile);
+
+    /// Time WeatherDataCollection::loadFromFiles (snapshot off) on the files
+    /// listed in dataSourceFile, then generateMonthlyStats for every year,
+    /// writing the reports under workDirectory. outOfCore loads into a
+    /// segment store there instead of memory.
+    void runCollectionBenchmark(const std::string& dataSourceFile, const std::string& workDirectory,
+                                bool outOfCore);
+
+    /// Bst of the timestamp keys of a chronological load of rows readings:
+    /// one at a time, bulk-loaded, copied and destroyed, and against a plain
+    /// (unbalanced) BST at the sizes where that finishes quickly.
+    void runBstBenchmark(long long rows);
+
+    /// Insert and lookup cost of each Map backend, for month keys and for
+    /// a larger set of sparse keys.
+    void runMapBenchmark();
+
+    /// Throughput (GB/s of input read) of each StatKernels reduction at
+    /// every instruction-set level the CPU supports, with its relative
+    /// difference from the scalar kernel.
+    void runKernelBenchmark();
+
+    /// Percentiles over a 20-year archive of synthetic monthly partitions:
+    /// time and rank error of merged Statistics::QuantileSketch partitions
+    /// against copying and selecting the exact values.
+    void runQuantileBenchmark();
+
+    /// Every benchmark above, on an archive of rows generated readings
+    /// written to a temporary directory and removed afterwards.
+    /// @return false if the archive could not be written
+    bool runAll(long long rows);
+}
+
+#endif // BENCHMARK_H
@@ -3,6 +3,14 @@
 
 #include <iostream>
 #include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 /// @class Node
 /// @brief Template node class for Binary Search Tree
@@ -12,31 +20,204 @@ public:
     T data;
     Node<T>* left;
     Node<T>* right;
+    int height; // height of the subtree rooted here (a leaf is 0)
+    int count;  // number of nodes in the subtree rooted here
 
-    Node(const T& value) : data(value), left(nullptr), right(nullptr) {}
+    Node(const T& value) : data(value), left(nullptr), right(nullptr), height(0), count(1) {}
+    Node(T&& value) : data(std::move(value)), left(nullptr), right(nullptr), height(0), count(1) {}
+};
+
+/// @class NodePool
+/// @brief Slab allocator for tree nodes
+///
+/// Nodes are carved out of blocks that double in size (up to MAX_BLOCK
+/// nodes), so a million-node tree needs a few dozen allocations instead of
+/// a million. Nodes are never freed one at a time; clear() destroys every
+/// node and releases all blocks in one go.
+template <class T>
+class NodePool {
+private:
+    struct Block {
+        Node<T>* nodes;
+        std::size_t capacity;
+        std::size_t used;
+    };
+
+    static constexpr std::size_t MIN_BLOCK = 64;
+    static constexpr std::size_t MAX_BLOCK = 65536;
+
+    std::vector<Block> blocks;
+    std::size_t nodeCount;
+
+    void addBlock(std::size_t capacity) {
+        Node<T>* storage = static_cast<Node<T>*>(::operator new(capacity * sizeof(Node<T>)));
+        blocks.push_back(Block{storage, capacity, 0});
+    }
+
+public:
+    NodePool() : blocks(), nodeCount(0) {}
+    ~NodePool() { clear(); }
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    NodePool(NodePool&& other) noexcept : blocks(std::move(other.blocks)), nodeCount(other.nodeCount) {
+        other.blocks.clear();
+        other.nodeCount = 0;
+    }
+
+    NodePool& operator=(NodePool&& other) noexcept {
+        if (this != &other) {
+            clear();
+            blocks = std::move(other.blocks);
+            nodeCount = other.nodeCount;
+            other.blocks.clear();
+            other.nodeCount = 0;
+        }
+        return *this;
+    }
+
+    /// Make room for at least count more nodes in a single block
+    void reserve(std::size_t count) {
+        if (!blocks.empty() && blocks.back().capacity - blocks.back().used >= count) return;
+        if (count > 0) addBlock(count);
+    }
+
+    template <class U>
+    Node<T>* create(U&& value) {
+        if (blocks.empty() || blocks.back().used == blocks.back().capacity) {
+            std::size_t capacity = blocks.empty() ? MIN_BLOCK : std::min(blocks.back().capacity * 2, MAX_BLOCK);
+            addBlock(std::max(capacity, MIN_BLOCK));
+        }
+        Block& block = blocks.back();
+        Node<T>* node = new (block.nodes + block.used) Node<T>(std::forward<U>(value));
+        block.used++;
+        nodeCount++;
+        return node;
+    }
+
+    void clear() {
+        for (Block& block : blocks) {
+            for (std::size_t i = 0; i < block.used; i++) {
+                block.nodes[i].~Node<T>();
+            }
+            ::operator delete(block.nodes);
+        }
+        blocks.clear();
+        nodeCount = 0;
+    }
+
+    std::size_t size() const { return nodeCount; }
+    std::size_t blockCount() const { return blocks.size(); }
+};
+
+template <class T>
+class Bst;
+
+/// @class BstIterator
+/// @brief In-order forward iterator over a Bst
+///
+/// Keeps the path of pending ancestors on an explicit stack, so stepping
+/// costs amortised O(1) and nothing recurses. Values are read-only because
+/// changing a key in place would break the ordering.
+template <class T>
+class BstIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    BstIterator() : path() {}
+    explicit BstIterator(Node<T>* root) : path() { pushLeft(root); }
+
+    reference operator*() const { return path.back()->data; }
+    pointer operator->() const { return &path.back()->data; }
+
+    BstIterator& operator++() {
+        Node<T>* node = path.back();
+        path.pop_back();
+        pushLeft(node->right);
+        return *this;
+    }
+
+    BstIterator operator++(int) {
+        BstIterator old = *this;
+        ++(*this);
+        return old;
+    }
+
+    bool operator==(const BstIterator& other) const {
+        if (path.empty() || other.path.empty()) return path.empty() == other.path.empty();
+        return path.back() == other.path.back();
+    }
+    bool operator!=(const BstIterator& other) const { return !(*this == other); }
+
+private:
+    friend class Bst<T>;
+
+    std::vector<Node<T>*> path; // the current node and its pending ancestors
+
+    // Bst::lowerBound/upperBound build the path themselves
+    explicit BstIterator(std::vector<Node<T>*>&& ancestors) : path(std::move(ancestors)) {}
+
+    void pushLeft(Node<T>* node) {
+        for (; node != nullptr; node = node->left) {
+            path.push_back(node);
+        }
+    }
 };
 
 /// @class Bst
 /// @brief Template Binary Search Tree with function pointers for traversal
+///
+/// Nodes come from a NodePool owned by the tree and are released together.
+///
+/// Traversals are iterative. Besides the function-pointer versions there are
+/// template overloads taking any callable (lambdas may capture); a visitor
+/// that returns bool stops the walk by returning false. begin()/end() give
+/// in-order iterators for range-for and the standard algorithms.
+///
+/// search, lowerBound, upperBound and visitRange also accept a key of
+/// another type K, as long as T < K and K < T are defined (for example a
+/// record compared directly with a Date). A range visit costs O(log n + k).
+///
+/// Every node also stores the size of its subtree, which makes size() O(1)
+/// and gives O(log n) rank, select and range counts (an order-statistic tree).
+///
+/// The tree is kept AVL-balanced: after each insert, every node's subtrees
+/// differ in height by at most one. Insert and search are O(log n) and the
+/// recursive helpers never go deeper than about 1.44 log2(n), even when the
+/// values arrive already sorted (as our time-ordered data files do).
 template <class T>
 class Bst {
 private:
     Node<T>* root;
+    NodePool<T> pool;
 
     // Private recursive helper methods
-    Node<T>* insertRec(Node<T>* node, const T& value);
+    template <class U>
+    Node<T>* insertRec(Node<T>* node, U&& value);
     Node<T>* searchRec(Node<T>* node, const T& value) const;
 
-    // Traversal methods with function pointers
-    void inOrderRec(Node<T>* node, void (*visit)(const T&)) const;
-    void preOrderRec(Node<T>* node, void (*visit)(const T&)) const;
-    void postOrderRec(Node<T>* node, void (*visit)(const T&)) const;
+    // AVL balancing
+    static int nodeHeight(const Node<T>* node);
+    static int nodeCount(const Node<T>* node);
+    static void updateNode(Node<T>* node);
+    static Node<T>* rotateLeft(Node<T>* node);
+    static Node<T>* rotateRight(Node<T>* node);
+    static Node<T>* rebalance(Node<T>* node);
 
-    // Traversal methods that collect data
-    void inOrderRec(Node<T>* node, void (*visit)(const T&, void*), void* context) const;
+    // Bulk loading
+    static Node<T>* buildBalanced(Node<T>* const* nodes, int first, int last);
+    void collectNodes(std::vector<Node<T>*>& nodes) const;
 
-    void deleteTreeRec(Node<T>* node);
-    bool checkInvariantRec(Node<T>* node, const T& min, const T& max) const;
+    // Calls visit and reports whether the traversal should go on
+    template <class Visitor>
+    static bool keepGoing(Visitor& visit, const T& value);
+
+    bool checkInvariantRec(Node<T>* node, const T* min, const T* max) const;
     Node<T>* copyTreeRec(Node<T>* node);
 
 public:
@@ -44,8 +225,25 @@ public:
     ~Bst();
     Bst(const Bst<T>& other);
     Bst<T>& operator=(const Bst<T>& other);
+    Bst(Bst<T>&& other) noexcept;
+    Bst<T>& operator=(Bst<T>&& other) noexcept;
+
+    template <class Key>
+    Node<T>* search(const Key& key) const;
 
     void insert(const T& value);
+    void insert(T&& value);
+    template <class... Args>
+    void emplace(Args&&... args);
+    void clear();
+
+    /// Insert a batch of values sorted in ascending order. An empty tree is
+    /// built perfectly balanced in O(m); otherwise the tree and batch are
+    /// merged and rebuilt in O(n + m), or inserted one by one when the batch
+    /// is small enough for that to be cheaper. Unsorted input falls back to
+    /// ordinary inserts. Values already present are skipped, as with insert.
+    template <class Iter>
+    void insertSorted(Iter first, Iter last);
     Node<T>* search(const T& value) const;
 
     // Traversal methods with function pointers
@@ -56,6 +254,30 @@ public:
     // Traversal methods that collect data into context
     void inOrder(void (*visit)(const T&, void*), void* context) const;
 
+    // Traversals with any callable. Return false if the visitor stopped early.
+    template <class Visitor>
+    bool inOrder(Visitor&& visit) const;
+    template <class Visitor>
+    bool preOrder(Visitor&& visit) const;
+    template <class Visitor>
+    bool postOrder(Visitor&& visit) const;
+
+    // In-order iteration
+    typedef BstIterator<T> const_iterator;
+    typedef const_iterator iterator;
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Ordered lookups; Key may be T or any type comparable with T
+    template <class Key>
+    const_iterator lowerBound(const Key& key) const; // first value not less than key
+    template <class Key>
+    const_iterator upperBound(const Key& key) const; // first value greater than key
+
+    /// Visit the values in [from, to) in order. Returns false if the visitor stopped early.
+    template <class Key, class Visitor>
+    bool visitRange(const Key& from, const Key& to, Visitor&& visit) const;
+
     // Simple traversals (for backward compatibility)
     void inOrder() const;
     void preOrder() const;
@@ -65,67 +287,148 @@ public:
     bool isEmpty() const;
     int size() const;
     int height() const;
+    int allocationCount() const; // node blocks currently held by the pool
 
-private:
-    int sizeRec(Node<T>* node) const;
-    int heightRec(Node<T>* node) const;
+    // Order statistics, all O(log n)
+    int rank(const T& value) const;                   // number of values < value
+    Node<T>* select(int k) const;                     // k-th smallest (0-based), nullptr if out of range
+    int countInRange(const T& low, const T& high) const; // number of values in [low, high)
 };
 
 // Template implementation
 
 template <class T>
-Bst<T>::Bst() : root(nullptr) {}
+Bst<T>::Bst() : root(nullptr), pool() {}
 
 template <class T>
 Bst<T>::~Bst() {
-    deleteTreeRec(root);
+    clear();
 }
 
 template <class T>
-Bst<T>::Bst(const Bst<T>& other) : root(nullptr) {
+Bst<T>::Bst(const Bst<T>& other) : root(nullptr), pool() {
+    pool.reserve(other.pool.size());
     root = copyTreeRec(other.root);
 }
 
 template <class T>
 Bst<T>& Bst<T>::operator=(const Bst<T>& other) {
     if (this != &other) {
-        deleteTreeRec(root);
+        clear();
+        pool.reserve(other.pool.size());
         root = copyTreeRec(other.root);
     }
     return *this;
 }
 
+template <class T>
+Bst<T>::Bst(Bst<T>&& other) noexcept : root(other.root), pool(std::move(other.pool)) {
+    other.root = nullptr;
+}
+
+template <class T>
+Bst<T>& Bst<T>::operator=(Bst<T>&& other) noexcept {
+    if (this != &other) {
+        clear();
+        root = other.root;
+        pool = std::move(other.pool);
+        other.root = nullptr;
+    }
+    return *this;
+}
+
+template <class T>
+void Bst<T>::clear() {
+    pool.clear();
+    root = nullptr;
+}
+
 template <class T>
 Node<T>* Bst<T>::copyTreeRec(Node<T>* node) {
     if (node == nullptr) return nullptr;
 
-    Node<T>* newNode = new Node<T>(node->data);
+    Node<T>* newNode = pool.create(node->data);
+    newNode->height = node->height;
+    newNode->count = node->count;
     newNode->left = copyTreeRec(node->left);
     newNode->right = copyTreeRec(node->right);
     return newNode;
 }
 
 template <class T>
-void Bst<T>::deleteTreeRec(Node<T>* node) {
-    if (node != nullptr) {
-        deleteTreeRec(node->left);
-        deleteTreeRec(node->right);
-        delete node;
+int Bst<T>::nodeHeight(const Node<T>* node) {
+    return node == nullptr ? -1 : node->height;
+}
+
+template <class T>
+int Bst<T>::nodeCount(const Node<T>* node) {
+    return node == nullptr ? 0 : node->count;
+}
+
+// Recompute the height and subtree size of node from its children
+template <class T>
+void Bst<T>::updateNode(Node<T>* node) {
+    node->height = 1 + std::max(nodeHeight(node->left), nodeHeight(node->right));
+    node->count = 1 + nodeCount(node->left) + nodeCount(node->right);
+}
+
+template <class T>
+Node<T>* Bst<T>::rotateLeft(Node<T>* node) {
+    Node<T>* newRoot = node->right;
+    node->right = newRoot->left;
+    newRoot->left = node;
+    updateNode(node);
+    updateNode(newRoot);
+    return newRoot;
+}
+
+template <class T>
+Node<T>* Bst<T>::rotateRight(Node<T>* node) {
+    Node<T>* newRoot = node->left;
+    node->left = newRoot->right;
+    newRoot->right = node;
+    updateNode(node);
+    updateNode(newRoot);
+    return newRoot;
+}
+
+// Restore the AVL property at node after one of its subtrees changed height by one
+template <class T>
+Node<T>* Bst<T>::rebalance(Node<T>* node) {
+    updateNode(node);
+    int balance = nodeHeight(node->left) - nodeHeight(node->right);
+
+    if (balance > 1) {
+        if (nodeHeight(node->left->left) < nodeHeight(node->left->right)) {
+            node->left = rotateLeft(node->left); // left-right case
+        }
+        return rotateRight(node);
+    }
+    if (balance < -1) {
+        if (nodeHeight(node->right->right) < nodeHeight(node->right->left)) {
+            node->right = rotateRight(node->right); // right-left case
+        }
+        return rotateLeft(node);
     }
+    return node;
 }
 
+// value is only moved from when a new node is created for it
 template <class T>
-Node<T>* Bst<T>::insertRec(Node<T>* node, const T& value) {
+template <class U>
+Node<T>* Bst<T>::insertRec(Node<T>* node, U&& value) {
     if (node == nullptr) {
-        return new Node<T>(value);
+        return pool.create(std::forward<U>(value));
     }
 
     if (value < node->data) {
-        node->left = insertRec(node->left, value);
+        node->left = insertRec(node->left, std::forward<U>(value));
     } else if (value > node->data) {
-        node->right = insertRec(node->right, value);
+        node->right = insertRec(node->right, std::forward<U>(value));
+    } else {
+        return node; // duplicate, tree unchanged
     }
-    return node;
+    return rebalance(node);
 }
 
 template <class T>
@@ -133,6 +436,19 @@ void Bst<T>::insert(const T& value) {
     root = insertRec(root, value);
 }
 
+template <class T>
+void Bst<T>::insert(T&& value) {
+    root = insertRec(root, std::move(value));
+}
+
+// The value has to exist before it can be compared, so it is built once
+// here and then moved into its node
+template <class T>
+template <class... Args>
+void Bst<T>::emplace(Args&&... args) {
+    root = insertRec(root, T(std::forward<Args>(args)...));
+}
+
 template <class T>
 Node<T>* Bst<T>::searchRec(Node<T>* node, const T& value) const {
     if (node == nullptr || node->data == value) {
@@ -151,62 +467,163 @@ Node<T>* Bst<T>::search(const T& value) const {
     return searchRec(root, value);
 }
 
-// Traversal with simple function pointer
 template <class T>
-void Bst<T>::inOrderRec(Node<T>* node, void (*visit)(const T&)) const {
-    if (node != nullptr) {
-        inOrderRec(node->left, visit);
-        visit(node->data);
-        inOrderRec(node->right, visit);
+template <class Visitor>
+bool Bst<T>::keepGoing(Visitor& visit, const T& value) {
+    if constexpr (std::is_convertible<decltype(visit(value)), bool>::value) {
+        return static_cast<bool>(visit(value));
+    } else {
+        visit(value);
+        return true;
     }
 }
 
 template <class T>
-void Bst<T>::inOrder(void (*visit)(const T&)) const {
-    inOrderRec(root, visit);
+template <class Visitor>
+bool Bst<T>::inOrder(Visitor&& visit) const {
+    std::vector<Node<T>*> stack;
+    Node<T>* node = root;
+
+    while (node != nullptr || !stack.empty()) {
+        for (; node != nullptr; node = node->left) {
+            stack.push_back(node);
+        }
+        node = stack.back();
+        stack.pop_back();
+        if (!keepGoing(visit, node->data)) return false;
+        node = node->right;
+    }
+    return true;
 }
 
 template <class T>
-void Bst<T>::preOrderRec(Node<T>* node, void (*visit)(const T&)) const {
-    if (node != nullptr) {
-        visit(node->data);
-        preOrderRec(node->left, visit);
-        preOrderRec(node->right, visit);
+template <class Visitor>
+bool Bst<T>::preOrder(Visitor&& visit) const {
+    std::vector<Node<T>*> stack;
+    if (root != nullptr) stack.push_back(root);
+
+    while (!stack.empty()) {
+        Node<T>* node = stack.back();
+        stack.pop_back();
+        if (!keepGoing(visit, node->data)) return false;
+        if (node->right != nullptr) stack.push_back(node->right);
+        if (node->left != nullptr) stack.push_back(node->left);
     }
+    return true;
 }
 
 template <class T>
-void Bst<T>::preOrder(void (*visit)(const T&)) const {
-    preOrderRec(root, visit);
+template <class Visitor>
+bool Bst<T>::postOrder(Visitor&& visit) const {
+    std::vector<Node<T>*> stack;
+    Node<T>* node = root;
+    Node<T>* lastVisited = nullptr;
+
+    while (node != nullptr || !stack.empty()) {
+        for (; node != nullptr; node = node->left) {
+            stack.push_back(node);
+        }
+        Node<T>* top = stack.back();
+        if (top->right != nullptr && top->right != lastVisited) {
+            node = top->right; // left side done, walk the right subtree first
+        } else {
+            if (!keepGoing(visit, top->data)) return false;
+            lastVisited = top;
+            stack.pop_back();
+        }
+    }
+    return true;
 }
 
 template <class T>
-void Bst<T>::postOrderRec(Node<T>* node, void (*visit)(const T&)) const {
-    if (node != nullptr) {
-        postOrderRec(node->left, visit);
-        postOrderRec(node->right, visit);
-        visit(node->data);
+template <class Key>
+Node<T>* Bst<T>::search(const Key& key) const {
+    Node<T>* node = root;
+    while (node != nullptr) {
+        if (node->data < key) {
+            node = node->right;
+        } else if (key < node->data) {
+            node = node->left;
+        } else {
+            return node;
+        }
     }
+    return nullptr;
 }
 
+// Nodes where the descent turns left are exactly the pending ancestors an
+// in-order iterator keeps, so the bound is returned as a ready iterator
 template <class T>
-void Bst<T>::postOrder(void (*visit)(const T&)) const {
-    postOrderRec(root, visit);
+template <class Key>
+typename Bst<T>::const_iterator Bst<T>::lowerBound(const Key& key) const {
+    std::vector<Node<T>*> path;
+    Node<T>* node = root;
+    while (node != nullptr) {
+        if (node->data < key) {
+            node = node->right;
+        } else {
+            path.push_back(node);
+            node = node->left;
+        }
+    }
+    return const_iterator(std::move(path));
+}
+
+template <class T>
+template <class Key>
+typename Bst<T>::const_iterator Bst<T>::upperBound(const Key& key) const {
+    std::vector<Node<T>*> path;
+    Node<T>* node = root;
+    while (node != nullptr) {
+        if (key < node->data) {
+            path.push_back(node);
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return const_iterator(std::move(path));
 }
 
-// Traversal with context for data collection
 template <class T>
-void Bst<T>::inOrderRec(Node<T>* node, void (*visit)(const T&, void*), void* context) const {
-    if (node != nullptr) {
-        inOrderRec(node->left, visit, context);
-        visit(node->data, context);
-        inOrderRec(node->right, visit, context);
+template <class Key, class Visitor>
+bool Bst<T>::visitRange(const Key& from, const Key& to, Visitor&& visit) const {
+    for (const_iterator it = lowerBound(from), last = end(); it != last && *it < to; ++it) {
+        if (!keepGoing(visit, *it)) return false;
     }
+    return true;
 }
 
+// Function-pointer traversals share the iterative versions above
+template <class T>
+void Bst<T>::inOrder(void (*visit)(const T&)) const {
+    inOrder([visit](const T& value) { visit(value); });
+}
+
+template <class T>
+void Bst<T>::preOrder(void (*visit)(const T&)) const {
+    preOrder([visit](const T& value) { visit(value); });
+}
+
+template <class T>
+void Bst<T>::postOrder(void (*visit)(const T&)) const {
+    postOrder([visit](const T& value) { visit(value); });
+}
+
+// Traversal with context for data collection
 template <class T>
 void Bst<T>::inOrder(void (*visit)(const T&, void*), void* context) const {
-    inOrderRec(root, visit, context);
+    inOrder([visit, context](const T& value) { visit(value, context); });
+}
+
+template <class T>
+typename Bst<T>::const_iterator Bst<T>::begin() const {
+    return const_iterator(root);
+}
+
+template <class T>
+typename Bst<T>::const_iterator Bst<T>::end() const {
+    return const_iterator();
 }
 
 // Simple traversals (backward compatibility)
@@ -231,23 +648,32 @@ void Bst<T>::postOrder() const {
     });
 }
 
+// Checks ordering (min/max are exclusive bounds, nullptr = unbounded),
+// stored heights and the AVL balance condition
 template <class T>
-bool Bst<T>::checkInvariantRec(Node<T>* node, const T& min, const T& max) const {
+bool Bst<T>::checkInvariantRec(Node<T>* node, const T* min, const T* max) const {
     if (node == nullptr) return true;
 
-    if (!(node->data > min) || !(node->data < max)) {
+    if ((min != nullptr && !(node->data > *min)) || (max != nullptr && !(node->data < *max))) {
+        return false;
+    }
+
+    int leftHeight = nodeHeight(node->left);
+    int rightHeight = nodeHeight(node->right);
+    if (node->height != 1 + std::max(leftHeight, rightHeight) || std::abs(leftHeight - rightHeight) > 1) {
+        return false;
+    }
+    if (node->count != 1 + nodeCount(node->left) + nodeCount(node->right)) {
         return false;
     }
 
-    return checkInvariantRec(node->left, min, node->data) &&
-           checkInvariantRec(node->right, node->data, max);
+    return checkInvariantRec(node->left, min, &node->data) &&
+           checkInvariantRec(node->right, &node->data, max);
 }
 
 template <class T>
 bool Bst<T>::checkInvariant() const {
-    T minVal = T();
-    T maxVal = T();
-    return checkInvariantRec(root, minVal, maxVal);
+    return checkInvariantRec(root, nullptr, nullptr);
 }
 
 template <class T>
@@ -256,25 +682,137 @@ bool Bst<T>::isEmpty() const {
 }
 
 template <class T>
-int Bst<T>::sizeRec(Node<T>* node) const {
-    if (node == nullptr) return 0;
-    return 1 + sizeRec(node->left) + sizeRec(node->right);
+int Bst<T>::size() const {
+    return nodeCount(root);
 }
 
 template <class T>
-int Bst<T>::size() const {
-    return sizeRec(root);
+int Bst<T>::allocationCount() const {
+    return static_cast<int>(pool.blockCount());
 }
 
 template <class T>
-int Bst<T>::heightRec(Node<T>* node) const {
-    if (node == nullptr) return -1;
-    return 1 + std::max(heightRec(node->left), heightRec(node->right));
+int Bst<T>::height() const {
+    return nodeHeight(root);
 }
 
+// Link nodes[first, last) (in order) into a perfectly balanced subtree
 template <class T>
-int Bst<T>::height() const {
-    return heightRec(root);
+Node<T>* Bst<T>::buildBalanced(Node<T>* const* nodes, int first, int last) {
+    if (first >= last) return nullptr;
+
+    int middle = first + (last - first) / 2;
+    Node<T>* node = nodes[middle];
+    node->left = buildBalanced(nodes, first, middle);
+    node->right = buildBalanced(nodes, middle + 1, last);
+    updateNode(node);
+    return node;
+}
+
+template <class T>
+void Bst<T>::collectNodes(std::vector<Node<T>*>& nodes) const {
+    nodes.reserve(nodes.size() + nodeCount(root));
+
+    std::vector<Node<T>*> stack;
+    Node<T>* node = root;
+    while (node != nullptr || !stack.empty()) {
+        for (; node != nullptr; node = node->left) {
+            stack.push_back(node);
+        }
+        node = stack.back();
+        stack.pop_back();
+        nodes.push_back(node);
+        node = node->right;
+    }
+}
+
+template <class T>
+template <class Iter>
+void Bst<T>::insertSorted(Iter first, Iter last) {
+    std::vector<T> batch(first, last);
+    if (batch.empty()) return;
+
+    bool sorted = true;
+    for (std::size_t i = 1; i < batch.size() && sorted; i++) {
+        sorted = !(batch[i] < batch[i - 1]);
+    }
+
+    // Individual inserts cost about m log n; a rebuild costs n + m
+    std::size_t existing = static_cast<std::size_t>(nodeCount(root));
+    std::size_t logSize = 1;
+    while ((std::size_t(1) << logSize) <= existing + batch.size()) logSize++;
+
+    if (!sorted || (existing > 0 && batch.size() * logSize < existing)) {
+        for (T& value : batch) {
+            insert(std::move(value));
+        }
+        return;
+    }
+
+    std::vector<Node<T>*> oldNodes;
+    collectNodes(oldNodes);
+
+    // Merge the existing nodes with new nodes for the batch, skipping duplicates
+    std::vector<Node<T>*> merged;
+    merged.reserve(oldNodes.size() + batch.size());
+    pool.reserve(batch.size());
+
+    std::size_t i = 0;
+    for (std::size_t j = 0; j < batch.size(); j++) {
+        while (i < oldNodes.size() && oldNodes[i]->data < batch[j]) {
+            merged.push_back(oldNodes[i++]);
+        }
+        bool duplicate = (i < oldNodes.size() && !(batch[j] < oldNodes[i]->data)) ||
+                         (!merged.empty() && !(merged.back()->data < batch[j]));
+        if (!duplicate) {
+            merged.push_back(pool.create(std::move(batch[j])));
+        }
+    }
+    while (i < oldNodes.size()) {
+        merged.push_back(oldNodes[i++]);
+    }
+
+    root = buildBalanced(merged.data(), 0, static_cast<int>(merged.size()));
+}
+
+template <class T>
+int Bst<T>::rank(const T& value) const {
+    int smaller = 0;
+    Node<T>* node = root;
+    while (node != nullptr) {
+        if (node->data < value) {
+            smaller += nodeCount(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return smaller;
+}
+
+template <class T>
+Node<T>* Bst<T>::select(int k) const {
+    if (k < 0 || k >= nodeCount(root)) return nullptr;
+
+    Node<T>* node = root;
+    while (node != nullptr) {
+        int leftCount = nodeCount(node->left);
+        if (k < leftCount) {
+            node = node->left;
+        } else if (k == leftCount) {
+            return node;
+        } else {
+            k -= leftCount + 1;
+            node = node->right;
+        }
+    }
+    return nullptr;
+}
+
+template <class T>
+int Bst<T>::countInRange(const T& low, const T& high) const {
+    if (!(low < high)) return 0;
+    return rank(high) - rank(low);
 }
 
 #endif // BST_H
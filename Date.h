@@ -1,38 +1,74 @@
 #ifndef DATE_H
 #define DATE_H
 
+#include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <iostream>
 #include <string>
 
+/// @class Date
+/// @brief A calendar date stored as one 32-bit day number (days since 1/1/1970)
+///
+/// Day, month and year are computed from the day number on demand, so a Date
+/// is 4 bytes and compares with a single integer compare. format and parse
+/// write to and read from caller-supplied char buffers without allocating.
+/// Out-of-range fields given to the constructor roll over (31/2 is 2 or 3 March).
 class Date {
 private:
-    int day;
-    int month;
-    int year;
+    std::int32_t days; // days since 1/1/1970, negative before
+
+    struct Fields {
+        int day;
+        int month;
+        int year;
+    };
+
+    static constexpr std::int32_t daysFromCivil(int year, int month, int day);
+    static constexpr Fields civilFromDays(std::int32_t dayNumber);
 
 public:
+    /// Longest text written by format, e.g. "31/12/-2000000"
+    static constexpr std::size_t MAX_FORMAT_LENGTH = 16;
+
     // Constructors
-    Date();
-    Date(int d, int m, int y);
+    constexpr Date();
+    constexpr Date(int d, int m, int y);
+
+    static constexpr Date fromDays(std::int32_t daysSinceEpoch);
 
     // Getters
-    int GetDay() const;
-    int GetMonth() const;
-    int GetYear() const;
+    constexpr std::int32_t GetDaysSinceEpoch() const;
+    constexpr int GetDay() const;
+    constexpr int GetMonth() const;
+    constexpr int GetYear() const;
 
     // Setters
     void SetDay(int d);
     void SetMonth(int m);
     void SetYear(int y);
 
+    // Calendar rules
+    static constexpr bool isLeapYear(int year);
+    static constexpr int daysInMonth(int month, int year);
+    static constexpr bool isValid(int d, int m, int y);
+
+    /// Write "d/m/yyyy" to [first, last).
+    /// @return one past the last character written, or nullptr if it does not fit
+    char* format(char* first, char* last) const;
+
+    /// Read "d/m/y" from [first, last); any single non-digit separates the fields.
+    /// @return one past the last character read, or nullptr if the text is not a valid date
+    static const char* parse(const char* first, const char* last, Date& date);
+
     // String conversion
     std::string toString() const;
 
     // Comparison operators
-    bool operator<(const Date& other) const;
-    bool operator>(const Date& other) const;
-    bool operator==(const Date& other) const;
-    bool operator!=(const Date& other) const;
+    constexpr bool operator<(const Date& other) const { return days < other.days; }
+    constexpr bool operator>(const Date& other) const { return days > other.days; }
+    constexpr bool operator==(const Date& other) const { return days == other.days; }
+    constexpr bool operator!=(const Date& other) const { return days != other.days; }
 
     // Stream operators
     friend std::ostream& operator<<(std::ostream& os, const Date& date);
@@ -40,52 +76,142 @@ public:
 };
 
 // Implementation INLINE in header
-inline Date::Date() : day(1), month(1), year(2000) {}
 
-inline Date::Date(int d, int m, int y) : day(d), month(m), year(y) {}
+// Howard Hinnant's days_from_civil: eras of 400 years, March-based years
+inline constexpr std::int32_t Date::daysFromCivil(int year, int month, int day) {
+    // Roll months outside 1..12 into the year first
+    year += (month > 0 ? month - 1 : month - 12) / 12;
+    month = ((month - 1) % 12 + 12) % 12 + 1;
+
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = year - era * 400;
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+inline constexpr Date::Fields Date::civilFromDays(std::int32_t dayNumber) {
+    const std::int32_t shifted = dayNumber + 719468;
+    const int era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+    const int dayOfEra = shifted - era * 146097;
+    const int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const int monthIndex = (5 * dayOfYear + 2) / 153; // 0 = March
+    const int day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    const int month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    const int year = yearOfEra + era * 400 + (month <= 2);
+    return Fields{day, month, year};
+}
 
-inline int Date::GetDay() const { return day; }
+inline constexpr Date::Date() : days(daysFromCivil(2000, 1, 1)) {}
 
-inline int Date::GetMonth() const { return month; }
+inline constexpr Date::Date(int d, int m, int y) : days(daysFromCivil(y, m, d)) {}
 
-inline int Date::GetYear() const { return year; }
+inline constexpr Date Date::fromDays(std::int32_t daysSinceEpoch) {
+    Date date;
+    date.days = daysSinceEpoch;
+    return date;
+}
 
-inline void Date::SetDay(int d) { day = d; }
+inline constexpr std::int32_t Date::GetDaysSinceEpoch() const { return days; }
 
-inline void Date::SetMonth(int m) { month = m; }
+inline constexpr int Date::GetDay() const { return civilFromDays(days).day; }
 
-inline void Date::SetYear(int y) { year = y; }
+inline constexpr int Date::GetMonth() const { return civilFromDays(days).month; }
 
-inline std::string Date::toString() const {
-    return std::to_string(day) + "/" + std::to_string(month) + "/" + std::to_string(year);
+inline constexpr int Date::GetYear() const { return civilFromDays(days).year; }
+
+inline void Date::SetDay(int d) {
+    Fields fields = civilFromDays(days);
+    days = daysFromCivil(fields.year, fields.month, d);
 }
 
-inline bool Date::operator<(const Date& other) const {
-    if (year != other.year) return year < other.year;
-    if (month != other.month) return month < other.month;
-    return day < other.day;
+inline void Date::SetMonth(int m) {
+    Fields fields = civilFromDays(days);
+    days = daysFromCivil(fields.year, m, fields.day);
 }
 
-inline bool Date::operator>(const Date& other) const {
-    return other < *this;
+inline void Date::SetYear(int y) {
+    Fields fields = civilFromDays(days);
+    days = daysFromCivil(y, fields.month, fields.day);
 }
 
-inline bool Date::operator==(const Date& other) const {
-    return day == other.day && month == other.month && year == other.year;
+inline constexpr bool Date::isLeapYear(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
 }
 
-inline bool Date::operator!=(const Date& other) const {
-    return !(*this == other);
+inline constexpr int Date::daysInMonth(int month, int year) {
+    if (month == 2) return isLeapYear(year) ? 29 : 28;
+    return (month == 4 || month == 6 || month == 9 || month == 11) ? 30 : 31;
+}
+
+inline constexpr bool Date::isValid(int d, int m, int y) {
+    return m >= 1 && m <= 12 && d >= 1 && d <= daysInMonth(m, y);
+}
+
+inline char* Date::format(char* first, char* last) const {
+    Fields fields = civilFromDays(days);
+
+    std::to_chars_result result = std::to_chars(first, last, fields.day);
+    if (result.ec != std::errc() || result.ptr == last) return nullptr;
+    *result.ptr++ = '/';
+
+    result = std::to_chars(result.ptr, last, fields.month);
+    if (result.ec != std::errc() || result.ptr == last) return nullptr;
+    *result.ptr++ = '/';
+
+    result = std::to_chars(result.ptr, last, fields.year);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+inline const char* Date::parse(const char* first, const char* last, Date& date) {
+    int fields[3] = {0, 0, 0};
+
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) {
+            // One separator, which must not start the next number
+            if (first == last || (*first >= '0' && *first <= '9') || *first == '-') return nullptr;
+            ++first;
+        }
+        std::from_chars_result result = std::from_chars(first, last, fields[i]);
+        if (result.ec != std::errc()) return nullptr;
+        first = result.ptr;
+    }
+
+    if (!isValid(fields[0], fields[1], fields[2])) return nullptr;
+    date = Date(fields[0], fields[1], fields[2]);
+    return first;
+}
+
+inline std::string Date::toString() const {
+    char buffer[MAX_FORMAT_LENGTH];
+    char* end = format(buffer, buffer + sizeof(buffer));
+    return std::string(buffer, end);
 }
 
 inline std::ostream& operator<<(std::ostream& os, const Date& date) {
-    os << date.day << "/" << date.month << "/" << date.year;
+    char buffer[Date::MAX_FORMAT_LENGTH];
+    char* end = date.format(buffer, buffer + sizeof(buffer));
+    os.write(buffer, end - buffer);
     return os;
 }
 
+// Reads one whitespace-delimited "d/m/y" token; sets failbit if it is not a valid date
 inline std::istream& operator>>(std::istream& is, Date& date) {
-    char slash1, slash2;
-    is >> date.day >> slash1 >> date.month >> slash2 >> date.year;
+    char buffer[Date::MAX_FORMAT_LENGTH];
+    std::size_t length = 0;
+
+    is >> std::ws;
+    while (length < sizeof(buffer)) {
+        int next = is.peek();
+        if (next == std::char_traits<char>::eof() || std::isspace(next)) break;
+        buffer[length++] = static_cast<char>(is.get());
+    }
+
+    if (Date::parse(buffer, buffer + length, date) != buffer + length) {
+        is.setstate(std::ios::failbit);
+    }
     return is;
 }
 
@@ -0,0 +1,129 @@
+#ifndef DATETIME_H
+#define DATETIME_H
+
+#include "Date.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+/// @class DateTime
+/// @brief A date and time of day to the minute, packed as minutes since 1/1/1970
+///
+/// One 64-bit integer, so ordering and equality are a single integer compare.
+/// Calendar conversions go through Date's day number.
+/// A Date converts implicitly to midnight at the start of that day, which makes
+/// Date usable as a range bound wherever a DateTime is expected.
+class DateTime {
+private:
+    std::int64_t minutes; // minutes since 1/1/1970 00:00
+
+public:
+    static const int MINUTES_PER_DAY = 24 * 60;
+    static constexpr std::size_t MAX_FORMAT_LENGTH = Date::MAX_FORMAT_LENGTH + 6;
+
+    // Constructors
+    constexpr DateTime();
+    constexpr DateTime(const Date& date, int hour = 0, int minute = 0);
+
+    static constexpr DateTime fromMinutes(std::int64_t minutesSinceEpoch);
+
+    // Getters
+    constexpr std::int64_t GetMinutesSinceEpoch() const;
+    constexpr Date GetDate() const;
+    int GetDay() const;
+    int GetMonth() const;
+    int GetYear() const;
+    int GetHour() const;
+    int GetMinute() const;
+
+    /// Write "d/m/yyyy h:mm" to [first, last).
+    /// @return one past the last character written, or nullptr if it does not fit
+    char* format(char* first, char* last) const;
+
+    // String conversion
+    std::string toString() const;
+
+    // Comparison operators
+    constexpr bool operator<(const DateTime& other) const { return minutes < other.minutes; }
+    constexpr bool operator>(const DateTime& other) const { return minutes > other.minutes; }
+    constexpr bool operator<=(const DateTime& other) const { return minutes <= other.minutes; }
+    constexpr bool operator>=(const DateTime& other) const { return minutes >= other.minutes; }
+    constexpr bool operator==(const DateTime& other) const { return minutes == other.minutes; }
+    constexpr bool operator!=(const DateTime& other) const { return minutes != other.minutes; }
+
+    // Stream operators
+    friend std::ostream& operator<<(std::ostream& os, const DateTime& dateTime);
+
+private:
+    constexpr std::int64_t daysSinceEpoch() const;
+};
+
+// Implementation INLINE in header
+inline constexpr DateTime::DateTime() : minutes(std::int64_t(Date().GetDaysSinceEpoch()) * MINUTES_PER_DAY) {}
+
+inline constexpr DateTime::DateTime(const Date& date, int hour, int minute)
+    : minutes(std::int64_t(date.GetDaysSinceEpoch()) * MINUTES_PER_DAY + hour * 60 + minute) {}
+
+inline constexpr DateTime DateTime::fromMinutes(std::int64_t minutesSinceEpoch) {
+    DateTime dateTime;
+    dateTime.minutes = minutesSinceEpoch;
+    return dateTime;
+}
+
+// Floor division, so times before 1970 still land on the right day
+inline constexpr std::int64_t DateTime::daysSinceEpoch() const {
+    std::int64_t days = minutes / MINUTES_PER_DAY;
+    return (minutes % MINUTES_PER_DAY < 0) ? days - 1 : days;
+}
+
+inline constexpr std::int64_t DateTime::GetMinutesSinceEpoch() const { return minutes; }
+
+inline constexpr Date DateTime::GetDate() const {
+    return Date::fromDays(static_cast<std::int32_t>(daysSinceEpoch()));
+}
+
+inline int DateTime::GetDay() const { return GetDate().GetDay(); }
+
+inline int DateTime::GetMonth() const { return GetDate().GetMonth(); }
+
+inline int DateTime::GetYear() const { return GetDate().GetYear(); }
+
+inline int DateTime::GetHour() const {
+    return static_cast<int>((minutes - daysSinceEpoch() * MINUTES_PER_DAY) / 60);
+}
+
+inline int DateTime::GetMinute() const {
+    return static_cast<int>((minutes - daysSinceEpoch() * MINUTES_PER_DAY) % 60);
+}
+
+inline char* DateTime::format(char* first, char* last) const {
+    first = GetDate().format(first, last);
+    if (first == nullptr || last - first < 6) return nullptr;
+
+    int minuteOfDay = static_cast<int>(minutes - daysSinceEpoch() * MINUTES_PER_DAY);
+    int hour = minuteOfDay / 60;
+    int minute = minuteOfDay % 60;
+
+    *first++ = ' ';
+    if (hour >= 10) *first++ = static_cast<char>('0' + hour / 10);
+    *first++ = static_cast<char>('0' + hour % 10);
+    *first++ = ':';
+    *first++ = static_cast<char>('0' + minute / 10);
+    *first++ = static_cast<char>('0' + minute % 10);
+    return first;
+}
+
+inline std::string DateTime::toString() const {
+    char buffer[MAX_FORMAT_LENGTH];
+    char* end = format(buffer, buffer + sizeof(buffer));
+    return std::string(buffer, end);
+}
+
+inline std::ostream& operator<<(std::ostream& os, const DateTime& dateTime) {
+    char buffer[DateTime::MAX_FORMAT_LENGTH];
+    char* end = dateTime.format(buffer, buffer + sizeof(buffer));
+    os.write(buffer, end - buffer);
+    return os;
+}
+
+#endif // DATETIME_H
@@ -0,0 +1,145 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : mappedData(nullptr), mappedSize(0),
+#ifdef _WIN32
+      fileHandle(nullptr), mappingHandle(nullptr),
+#endif
+      isOpenFlag(false) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappedSize = static_cast<std::size_t>(fileSize.QuadPart);
+    isOpenFlag = true;
+
+    // A zero-length file cannot be mapped, but is still a valid (empty) file
+    if (mappedSize == 0) {
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        close();
+        return false;
+    }
+    mappingHandle = mapping;
+
+    mappedData = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (mappedData == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+    if (mappedData != nullptr) {
+        UnmapViewOfFile(mappedData);
+    }
+    if (mappingHandle != nullptr) {
+        CloseHandle(static_cast<HANDLE>(mappingHandle));
+    }
+    if (fileHandle != nullptr) {
+        CloseHandle(static_cast<HANDLE>(fileHandle));
+    }
+    mappedData = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    mappedSize = 0;
+    isOpenFlag = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    mappedSize = static_cast<std::size_t>(fileInfo.st_size);
+    isOpenFlag = true;
+
+    // A zero-length file cannot be mapped, but is still a valid (empty) file
+    if (mappedSize == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    void* address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps its own reference to the file
+
+    if (address == MAP_FAILED) {
+        mappedSize = 0;
+        isOpenFlag = false;
+        return false;
+    }
+
+    madvise(address, mappedSize, MADV_SEQUENTIAL);
+    mappedData = static_cast<const char*>(address);
+    return true;
+}
+
+void MappedFile::close() {
+    if (mappedData != nullptr) {
+        munmap(const_cast<char*>(mappedData), mappedSize);
+    }
+    mappedData = nullptr;
+    mappedSize = 0;
+    isOpenFlag = false;
+}
+
+#endif
+
+bool MappedFile::isOpen() const {
+    return isOpenFlag;
+}
+
+const char* MappedFile::data() const {
+    return mappedData;
+}
+
+std::size_t MappedFile::size() const {
+    return mappedSize;
+}
+
+std::string_view MappedFile::view() const {
+    return std::string_view(mappedData, mappedSize);
+}
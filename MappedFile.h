@@ -0,0 +1,41 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+/// @class MappedFile
+/// @brief Read-only memory mapping of a whole file
+///
+/// The mapping is released when the object is closed or destroyed.
+/// Empty files open successfully and expose an empty view.
+class MappedFile {
+private:
+    const char* mappedData;
+    std::size_t mappedSize;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const;
+    const char* data() const;
+    std::size_t size() const;
+    std::string_view view() const;
+
+private:
+    bool isOpenFlag;
+};
+
+#endif // MAPPEDFILE_H
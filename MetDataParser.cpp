@@ -0,0 +1,340 @@
+#include "MetDataParser.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    const char* skipSpaces(const char* first, const char* last) {
+        while (first != last && isSpace(*first)) {
+            ++first;
+        }
+        return first;
+    }
+
+    // Reads an int in the same way as "stream >> int" would
+    const char* parseInt(const char* first, const char* last, int& value) {
+        first = skipSpaces(first, last);
+        if (first != last && *first == '+') {
+            ++first;
+        }
+        std::from_chars_result result = std::from_chars(first, last, value);
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+
+    constexpr Date EARLIEST_DATE(1, 1, 1900);
+    constexpr Date LATEST_DATE(31, 12, 2100);
+}
+
+const char* const MetDataParser::DATE_HEADER = "WAST";
+const char* const MetDataParser::WIND_SPEED_HEADER = "S";
+const char* const MetDataParser::SOLAR_RADIATION_HEADER = "SR";
+const char* const MetDataParser::TEMPERATURE_HEADER = "T";
+
+MetDataParser::MetDataParser() : fieldOfColumn(), lastColumn(-1), missingColumn() {}
+
+bool MetDataParser::readHeader(std::string_view headerLine, const std::vector<std::string>& extraHeaders) {
+    const char* const names[FIELD_COUNT] = {DATE_HEADER, WIND_SPEED_HEADER, SOLAR_RADIATION_HEADER,
+                                            TEMPERATURE_HEADER};
+    int columnOf[FIELD_COUNT] = {-1, -1, -1, -1};
+    std::vector<int> columnOfExtra(extraHeaders.size(), -1);
+
+    int column = 0;
+    std::size_t start = 0;
+    while (start <= headerLine.size()) {
+        std::size_t comma = headerLine.find(',', start);
+        std::size_t end = (comma == std::string_view::npos) ? headerLine.size() : comma;
+
+        std::string_view name = headerLine.substr(start, end - start);
+        std::size_t first = name.find_first_not_of(" \t");
+        std::size_t last = name.find_last_not_of(" \t");
+        name = (first == std::string_view::npos) ? std::string_view() : name.substr(first, last - first + 1);
+
+        for (int field = 0; field < FIELD_COUNT; field++) {
+            // First match wins if a name is repeated
+            if (columnOf[field] < 0 && name == names[field]) {
+                columnOf[field] = column;
+            }
+        }
+        // Some exports label the timestamp column "Date" instead of "WAST"
+        if (columnOf[DATE_FIELD] < 0 && name == "Date") {
+            columnOf[DATE_FIELD] = column;
+        }
+        for (std::size_t extra = 0; extra < extraHeaders.size(); extra++) {
+            if (columnOfExtra[extra] < 0 && name == extraHeaders[extra]) {
+                columnOfExtra[extra] = column;
+            }
+        }
+
+        if (comma == std::string_view::npos) break;
+        start = comma + 1;
+        column++;
+    }
+
+    fieldOfColumn.clear();
+    lastColumn = -1;
+    missingColumn.clear();
+
+    for (int field = 0; field < FIELD_COUNT; field++) {
+        if (columnOf[field] < 0) {
+            missingColumn = names[field];
+            return false;
+        }
+        lastColumn = std::max(lastColumn, columnOf[field]);
+    }
+    for (std::size_t extra = 0; extra < extraHeaders.size(); extra++) {
+        if (columnOfExtra[extra] < 0) {
+            missingColumn = extraHeaders[extra];
+            lastColumn = -1;
+            return false;
+        }
+        lastColumn = std::max(lastColumn, columnOfExtra[extra]);
+    }
+
+    fieldOfColumn.assign(lastColumn + 1, -1);
+    for (int field = 0; field < FIELD_COUNT; field++) {
+        fieldOfColumn[columnOf[field]] = static_cast<short>(field);
+    }
+    for (std::size_t extra = 0; extra < extraHeaders.size(); extra++) {
+        fieldOfColumn[columnOfExtra[extra]] = static_cast<short>(FIELD_COUNT + extra);
+    }
+    return true;
+}
+
+bool MetDataParser::hasLayout() const {
+    return lastColumn >= 0;
+}
+
+const std::string& MetDataParser::getMissingColumn() const {
+    return missingColumn;
+}
+
+std::string_view MetDataParser::nextLine(std::string_view& buffer) {
+    std::size_t end = buffer.find('\n');
+    std::string_view line;
+
+    if (end == std::string_view::npos) {
+        line = buffer;
+        buffer = std::string_view();
+    } else {
+        line = buffer.substr(0, end);
+        buffer.remove_prefix(end + 1);
+    }
+
+    // Files written on Windows end their lines with \r\n
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+bool MetDataParser::isBlankLine(std::string_view line) {
+    return line.find_first_not_of(" ,\t\r\n") == std::string_view::npos;
+}
+
+bool MetDataParser::isHeaderLine(std::string_view line) {
+    return line.find("WAST") != std::string_view::npos || line.find("Date") != std::string_view::npos;
+}
+
+DateTime MetDataParser::parseDateTime(std::string_view dateTimeField) {
+    std::size_t spacePos = dateTimeField.find(' ');
+    if (spacePos == std::string_view::npos) {
+        throw std::invalid_argument("Invalid date format");
+    }
+
+    // d/m/yyyy - any single separator character is accepted between fields
+    std::string_view datePart = dateTimeField.substr(0, spacePos);
+    const char* last = datePart.data() + datePart.size();
+
+    Date date;
+    if (Date::parse(datePart.data(), last, date) != last || date < EARLIEST_DATE || LATEST_DATE < date) {
+        throw std::invalid_argument("Invalid date: " + std::string(datePart));
+    }
+
+    // hh:mm
+    std::string_view timePart = dateTimeField.substr(spacePos + 1);
+    const char* pos = timePart.data();
+    last = timePart.data() + timePart.size();
+
+    int hour = 0, minute = 0;
+    pos = parseInt(pos, last, hour);
+    if (pos != nullptr && pos != last && *pos == ':') pos = parseInt(pos + 1, last, minute);
+    else pos = nullptr;
+
+    if (pos == nullptr) {
+        throw std::invalid_argument("Failed to parse time");
+    }
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        throw std::invalid_argument("Invalid time values: " + std::string(timePart));
+    }
+
+    return DateTime(date, hour, minute);
+}
+
+double MetDataParser::parseDouble(std::string_view field) {
+    const char* first = skipSpaces(field.data(), field.data() + field.size());
+    const char* last = field.data() + field.size();
+    if (first != last && *first == '+') {
+        ++first;
+    }
+
+    double value = 0.0;
+    std::from_chars_result result = std::from_chars(first, last, value);
+
+    if (result.ec == std::errc::result_out_of_range) {
+        throw std::out_of_range("Numeric value out of range: " + std::string(field));
+    }
+    if (result.ec != std::errc()) {
+        throw std::invalid_argument("Invalid numeric value: " + std::string(field));
+    }
+    return value;
+}
+
+bool MetDataParser::parseRecord(std::string_view line, WeatherRecord& record, double* extraValues) const {
+    std::string_view fields[FIELD_COUNT];
+
+    // Walk the commas up to the last column we need; the rest of the row is never touched
+    std::size_t start = 0;
+    int column = 0;
+    for (;;) {
+        std::size_t comma = line.find(',', start);
+        std::size_t end = (comma == std::string_view::npos) ? line.size() : comma;
+
+        int field = fieldOfColumn[column];
+        if (field >= FIELD_COUNT) {
+            extraValues[field - FIELD_COUNT] = parseDouble(line.substr(start, end - start));
+        } else if (field >= 0) {
+            fields[field] = line.substr(start, end - start);
+        }
+        if (column == lastColumn) break;
+
+        // Row ended early (a trailing comma does not start a new column)
+        if (comma == std::string_view::npos || comma + 1 == line.size()) {
+            return false;
+        }
+        start = comma + 1;
+        column++;
+    }
+
+    record.timestamp = parseDateTime(fields[DATE_FIELD]);
+    record.windSpeed = parseDouble(fields[WIND_SPEED_FIELD]);
+    record.solarRadiation = parseDouble(fields[SOLAR_RADIATION_FIELD]);
+    record.temperature = parseDouble(fields[TEMPERATURE_FIELD]);
+    return true;
+}
+
+void MetDataParser::parseFile(const std::string& filename, RecordBatch& batch,
+                              std::size_t startOffset, bool wholeLinesOnly, std::size_t maxBytes) {
+    batch.filename = filename;
+    batch.endOffset = startOffset;
+
+    MappedFile dataFile;
+    if (!dataFile.open(filename)) {
+        batch.opened = false;
+        return;
+    }
+    batch.opened = true;
+
+    std::string_view contents = dataFile.view();
+    if (startOffset > contents.size()) {
+        batch.messages.push_back("Warning: " + filename + " is shorter than the data already loaded from it;"
+                                 " ignoring it until it grows");
+        return;
+    }
+
+    std::string_view remaining = contents.substr(startOffset);
+    if (wholeLinesOnly) {
+        // Leave a partly written last line for the next pass
+        std::size_t lastNewline = remaining.rfind('\n');
+        remaining = (lastNewline == std::string_view::npos) ? std::string_view() : remaining.substr(0, lastNewline + 1);
+    }
+    if (maxBytes > 0 && remaining.size() > maxBytes) {
+        std::size_t lineEnd = remaining.find('\n', maxBytes - 1);
+        if (lineEnd != std::string_view::npos) remaining = remaining.substr(0, lineEnd + 1);
+    }
+    batch.bytes = remaining.size();
+    batch.endOffset = startOffset + remaining.size();
+
+    bool firstLine = true;
+    MetDataParser parser;
+    WeatherRecord record(DateTime(), 0.0, 0.0, 0.0);
+    std::vector<double> extras(batch.extraColumns.size());
+
+    if (startOffset > 0) {
+        // The header was consumed by an earlier pass; read it again for the column layout
+        std::string_view consumed = contents.substr(0, startOffset);
+        while (firstLine && !consumed.empty()) {
+            std::string_view line = nextLine(consumed);
+            if (!line.empty() && isHeaderLine(line)) {
+                if (!parser.readHeader(line, batch.extraColumns)) {
+                    batch.messages.push_back("Error: Column '" + parser.getMissingColumn() +
+                                             "' not found in header of " + filename);
+                    return;
+                }
+                firstLine = false;
+            }
+        }
+    }
+
+    while (!remaining.empty()) {
+        std::string_view line = nextLine(remaining);
+        if (line.empty()) continue;
+
+        if (firstLine)
+        {
+            if (isHeaderLine(line))
+            {
+                if (!parser.readHeader(line, batch.extraColumns)) {
+                    batch.messages.push_back("Error: Column '" + parser.getMissingColumn() +
+                                             "' not found in header of " + filename);
+                    return;
+                }
+                firstLine = false;
+            }
+            continue;
+        }
+        batch.rows++;
+
+        // Skip lines that are just commas or whitespace
+        if (isBlankLine(line)) continue;
+
+        try {
+            if (!parser.parseRecord(line, record, extras.data())) {
+                batch.messages.push_back("Warning: Skipping line with insufficient columns: " + std::string(line));
+                continue;
+            }
+            batch.records.push_back(record);
+            batch.extraValues.insert(batch.extraValues.end(), extras.begin(), extras.end());
+        } catch (const std::exception& e) {
+            batch.messages.push_back("Error parsing line: " + std::string(line) + " - " + e.what());
+        }
+    }
+}
+
+bool MetDataParser::readSourceList(const std::string& dataSourceFile, std::vector<std::string>& filenames) {
+    std::ifstream sourceFile(dataSourceFile);
+    if (!sourceFile.is_open()) {
+        return false;
+    }
+
+    std::string filename;
+    while (std::getline(sourceFile, filename)) {
+        if (filename.empty() || filename[0] == '#')
+            continue;
+
+        // Remove any extra whitespace
+        filename.erase(0, filename.find_first_not_of(" \t"));
+        filename.erase(filename.find_last_not_of(" \t") + 1);
+
+        if (filename.empty()) continue;
+
+        filenames.push_back(filename);
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef METDATAPARSER_H
+#define METDATAPARSER_H
+
+#include "DateTime.h"
+#include "WeatherData.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @struct RecordBatch
+/// @brief Records parsed from one data file, plus the diagnostics raised on the way
+struct RecordBatch {
+    std::string filename;
+    std::vector<std::string> extraColumns; // set before parsing: other columns to keep, by header name
+    bool opened = false;
+    std::size_t bytes = 0;              // bytes scanned in this pass
+    std::size_t endOffset = 0;          // file offset just past the last byte consumed
+    long long rows = 0;                 // data lines seen after the header
+    std::vector<WeatherRecord> records; // in file order
+    std::vector<double> extraValues;    // extraColumns.size() values per record, record by record
+    std::vector<std::string> messages;  // warnings/errors, in file order
+};
+
+/// @class MetDataParser
+/// @brief In-place scanner for MetData CSV text
+///
+/// Works on std::string_view slices of a buffer (usually a MappedFile),
+/// so no per-row or per-field strings are allocated. Numbers and timestamps
+/// are converted with std::from_chars.
+///
+/// The positions of the columns we keep are resolved from each file's
+/// header line (readHeader), so files with reordered or extra columns load
+/// correctly. parseRecord only slices fields up to the last needed column.
+/// Besides S, T and SR, any other columns a caller names are read as extras.
+class MetDataParser {
+public:
+    // Header names of the columns we keep
+    static const char* const DATE_HEADER;
+    static const char* const WIND_SPEED_HEADER;
+    static const char* const SOLAR_RADIATION_HEADER;
+    static const char* const TEMPERATURE_HEADER;
+
+    MetDataParser();
+
+    /// Resolve the needed columns from a header line, plus extraHeaders in
+    /// that order (names are matched with surrounding blanks trimmed). Extra
+    /// headers must not repeat WAST, Date, S, SR or T.
+    /// @return false if a required column is missing; see getMissingColumn()
+    bool readHeader(std::string_view headerLine, const std::vector<std::string>& extraHeaders = {});
+    bool hasLayout() const;
+    const std::string& getMissingColumn() const;
+
+    // Line handling
+    static std::string_view nextLine(std::string_view& buffer);
+    static bool isBlankLine(std::string_view line);
+    static bool isHeaderLine(std::string_view line);
+
+    // Field parsing. These throw std::invalid_argument / std::out_of_range on bad input.
+    static DateTime parseDateTime(std::string_view dateTimeField); // "dd/mm/yyyy hh:mm"
+    static double parseDouble(std::string_view field);
+
+    /// Parse one data row into record using the layout from readHeader, and
+    /// its extra columns into extraValues (one per extra header, in order).
+    /// @return false if the row ends before the last needed column
+    bool parseRecord(std::string_view line, WeatherRecord& record, double* extraValues = nullptr) const;
+
+    /// Map filename and parse its data rows from startOffset onwards into batch,
+    /// with the extra columns batch.extraColumns names.
+    /// With wholeLinesOnly, an unterminated last line is left unconsumed.
+    /// A nonzero maxBytes stops at the end of the line that reaches it, so a
+    /// large file can be read in bounded batches by starting the next call
+    /// at batch.endOffset.
+    /// Never throws; bad rows are reported through batch.messages.
+    static void parseFile(const std::string& filename, RecordBatch& batch,
+                          std::size_t startOffset = 0, bool wholeLinesOnly = false, std::size_t maxBytes = 0);
+
+    /// Read the list of data file names from a data source file.
+    /// Blank lines and lines starting with '#' are skipped.
+    static bool readSourceList(const std::string& dataSourceFile, std::vector<std::string>& filenames);
+
+private:
+    enum Field { DATE_FIELD, WIND_SPEED_FIELD, SOLAR_RADIATION_FIELD, TEMPERATURE_FIELD, FIELD_COUNT };
+
+    std::vector<short> fieldOfColumn;       // column index -> Field (FIELD_COUNT + i for extra i), or -1 if unused
+    int lastColumn;                         // index of the last column we need
+    std::string missingColumn;
+};
+
+#endif // METDATAPARSER_H
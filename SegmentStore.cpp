@@ -0,0 +1,787 @@
+#include "SegmentStore.h"
+#include "WeatherData.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <type_traits>
+
+namespace
+{
+    const char SEGMENT_MAGIC[8] = {'W', 'X', 'S', 'E', 'G', '\0', '\0', '\0'};
+    const char* const SEGMENT_EXTENSION = ".seg";
+    const char* const MANIFEST_NAME = "ingested.txt";
+    const char* const COLUMNS_NAME = "columns.txt";
+    const char* const JOURNAL_NAME = "pending.txt";
+    const char* const STAGED_SUFFIX = ".tmp";
+
+    // The timestamp section is read in place as DateTimes
+    static_assert(sizeof(DateTime) == sizeof(std::int64_t) && std::is_trivially_copyable<DateTime>::value,
+                  "DateTime must be laid out as its int64 minute count");
+
+    struct SegmentHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t blockCount;
+        std::uint64_t rowCount;
+        std::uint64_t byteSize;
+        std::uint32_t extraCount;
+        std::uint32_t reserved;
+    };
+
+    struct BlockHeader {
+        std::uint64_t rowCount;
+    };
+
+    std::size_t bytesPerRow(std::size_t extraCount) {
+        return sizeof(std::int64_t) + (3 + extraCount) * sizeof(double);
+    }
+
+    bool readHeader(std::istream& in, SegmentHeader& header) {
+        return in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+               std::memcmp(header.magic, SEGMENT_MAGIC, sizeof(header.magic)) == 0 &&
+               header.version == Segment::VERSION;
+    }
+
+    SegmentHeader makeHeader(const Segment::Extent& extent) {
+        SegmentHeader header;
+        std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(header.magic));
+        header.version = Segment::VERSION;
+        header.blockCount = extent.blocks;
+        header.rowCount = extent.rows;
+        header.byteSize = extent.bytes;
+        header.extraCount = extent.extraColumns;
+        header.reserved = 0;
+        return header;
+    }
+
+    template <class T>
+    void writeColumn(std::ostream& out, const std::vector<T>& values) {
+        if (!values.empty()) {
+            out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+    }
+
+    // One block of records: its row count, then each column, extra columns last
+    void writeBlock(std::ostream& out, const std::vector<WeatherRecord>& records,
+                    const std::vector<double>& extraValues, std::size_t extraCount) {
+        std::vector<std::int64_t> timestampValues;
+        std::vector<double> windValues, temperatureValues, solarValues;
+        timestampValues.reserve(records.size());
+        windValues.reserve(records.size());
+        temperatureValues.reserve(records.size());
+        solarValues.reserve(records.size());
+
+        for (const WeatherRecord& record : records) {
+            timestampValues.push_back(record.timestamp.GetMinutesSinceEpoch());
+            windValues.push_back(record.windSpeed);
+            temperatureValues.push_back(record.temperature);
+            solarValues.push_back(record.solarRadiation);
+        }
+
+        BlockHeader header{records.size()};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeColumn(out, timestampValues);
+        writeColumn(out, windValues);
+        writeColumn(out, temperatureValues);
+        writeColumn(out, solarValues);
+
+        std::vector<double> extraColumn(records.size());
+        for (std::size_t column = 0; column < extraCount; column++) {
+            for (std::size_t row = 0; row < records.size(); row++) {
+                extraColumn[row] = extraValues[row * extraCount + column];
+            }
+            writeColumn(out, extraColumn);
+        }
+    }
+
+    // Stable sort of records into time order, each taking its extraCount
+    // extra values with it
+    void sortRows(std::vector<WeatherRecord>& records, std::vector<double>& extraValues, std::size_t extraCount) {
+        if (std::is_sorted(records.begin(), records.end())) return;
+
+        std::vector<std::size_t> order(records.size());
+        std::iota(order.begin(), order.end(), std::size_t(0));
+        std::stable_sort(order.begin(), order.end(),
+                         [&records](std::size_t a, std::size_t b) { return records[a] < records[b]; });
+
+        std::vector<WeatherRecord> sortedRecords;
+        std::vector<double> sortedValues;
+        sortedRecords.reserve(records.size());
+        sortedValues.reserve(extraValues.size());
+        for (std::size_t row : order) {
+            sortedRecords.push_back(records[row]);
+            sortedValues.insert(sortedValues.end(), extraValues.begin() + row * extraCount,
+                                extraValues.begin() + (row + 1) * extraCount);
+        }
+        records.swap(sortedRecords);
+        extraValues.swap(sortedValues);
+    }
+
+    // Segment files are named yyyy-mm.seg; returns false for any other name
+    bool parseSegmentName(const std::string& name, int& key) {
+        const char* first = name.data();
+        const char* last = name.data() + name.size();
+        std::size_t extensionLength = std::strlen(SEGMENT_EXTENSION);
+        if (name.size() <= extensionLength || name.compare(name.size() - extensionLength, extensionLength,
+                                                           SEGMENT_EXTENSION) != 0) {
+            return false;
+        }
+        last -= extensionLength;
+
+        int year = 0, month = 0;
+        std::from_chars_result result = std::from_chars(first, last, year);
+        if (result.ec != std::errc() || result.ptr == last || *result.ptr != '-') return false;
+        result = std::from_chars(result.ptr + 1, last, month);
+        if (result.ec != std::errc() || result.ptr != last || month < 1 || month > 12) return false;
+
+        key = SegmentStore::partitionKey(year, month);
+        return true;
+    }
+
+    template <class T>
+    bool parseNumber(const std::string& text, T& value) {
+        return std::from_chars(text.data(), text.data() + text.size(), value).ec == std::errc();
+    }
+
+    bool endsWith(const std::string& text, const std::string& suffix) {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // Move a staged file over path. A missing staged file means this rename
+    // already happened (replaying a journal after a crash).
+    bool moveIntoPlace(const std::string& path) {
+        std::string stagedPath = path + STAGED_SUFFIX;
+        std::error_code error;
+        if (!std::filesystem::exists(stagedPath, error)) {
+            return std::filesystem::exists(path, error);
+        }
+        std::remove(path.c_str()); // rename does not replace an existing file on Windows
+        return std::rename(stagedPath.c_str(), path.c_str()) == 0;
+    }
+}
+
+// Segment implementation
+Segment::Segment() : file(), rowCount(0), extraCount(0), blockOffsets() {}
+
+bool Segment::open(const std::string& path) {
+    blockOffsets.clear();
+    if (!file.open(path) || file.size() < sizeof(SegmentHeader)) {
+        file.close();
+        return false;
+    }
+
+    SegmentHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SEGMENT_MAGIC, sizeof(header.magic)) != 0 || header.version != VERSION ||
+        header.byteSize > file.size()) {
+        file.close();
+        return false;
+    }
+
+    // Walk the committed blocks; their sizes must add up to the header's extent
+    std::size_t rowBytes = bytesPerRow(header.extraCount);
+    std::uint64_t offset = sizeof(SegmentHeader);
+    std::uint64_t rows = 0;
+    while (offset < header.byteSize && blockOffsets.size() < header.blockCount) {
+        BlockHeader block;
+        if (header.byteSize - offset < sizeof(block)) break;
+        std::memcpy(&block, file.data() + offset, sizeof(block));
+        if ((header.byteSize - offset - sizeof(block)) / rowBytes < block.rowCount) break;
+
+        blockOffsets.push_back(offset);
+        rows += block.rowCount;
+        offset += sizeof(block) + block.rowCount * rowBytes;
+    }
+    if (offset != header.byteSize || blockOffsets.size() != header.blockCount || rows != header.rowCount) {
+        blockOffsets.clear();
+        file.close();
+        return false;
+    }
+
+    rowCount = static_cast<std::size_t>(rows);
+    extraCount = header.extraCount;
+    return true;
+}
+
+std::size_t Segment::size() const { return rowCount; }
+
+std::size_t Segment::mappedBytes() const { return file.size(); }
+
+std::size_t Segment::extraColumnCount() const { return extraCount; }
+
+std::size_t Segment::blockCount() const { return blockOffsets.size(); }
+
+RecordSlice Segment::block(std::size_t index) const {
+    BlockHeader header;
+    std::memcpy(&header, file.data() + blockOffsets[index], sizeof(header));
+    std::size_t n = static_cast<std::size_t>(header.rowCount);
+
+    const char* base = file.data() + blockOffsets[index] + sizeof(header);
+    const double* windSpeeds = reinterpret_cast<const double*>(base + n * sizeof(std::int64_t));
+    return RecordSlice{reinterpret_cast<const DateTime*>(base), windSpeeds, windSpeeds + n, windSpeeds + 2 * n, n,
+                       windSpeeds + 3 * n, 1, n};
+}
+
+DateTime Segment::lastTimestamp() const {
+    for (std::size_t index = blockOffsets.size(); index-- > 0;) {
+        RecordSlice slice = block(index);
+        if (slice.size > 0) return slice.timestamps[slice.size - 1];
+    }
+    return DateTime();
+}
+
+bool Segment::write(const std::string& path, const std::vector<WeatherRecord>& records,
+                    const std::vector<double>& extraValues, std::uint32_t extraColumns, Extent& written) {
+    written.rows = records.size();
+    written.blocks = 1;
+    written.bytes = sizeof(SegmentHeader) + sizeof(BlockHeader) + records.size() * bytesPerRow(extraColumns);
+    written.extraColumns = extraColumns;
+    SegmentHeader header = makeHeader(written);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeBlock(out, records, extraValues, extraColumns);
+
+    out.close();
+    if (out.fail()) {
+        std::remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Segment::appendBlock(const std::string& path, const Extent& committed, const std::vector<WeatherRecord>& records,
+                          const std::vector<double>& extraValues, std::uint32_t extraColumns, Extent& grown) {
+    Extent start = committed;
+    if (start.bytes > 0 && start.extraColumns != extraColumns) {
+        return false;
+    }
+    if (start.bytes == 0) {
+        // A new segment: an empty committed header, so a crash leaves no rows
+        start = Extent();
+        start.bytes = sizeof(SegmentHeader);
+        start.extraColumns = extraColumns;
+        SegmentHeader header = makeHeader(start);
+        std::ofstream created(path, std::ios::binary | std::ios::trunc);
+        created.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        created.close();
+        if (created.fail()) {
+            return false;
+        }
+    }
+
+    std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!out.is_open()) {
+        return false;
+    }
+    out.seekp(static_cast<std::streamoff>(start.bytes));
+    writeBlock(out, records, extraValues, extraColumns);
+    out.close();
+    if (out.fail()) {
+        return false;
+    }
+
+    grown.rows = start.rows + records.size();
+    grown.blocks = start.blocks + 1;
+    grown.bytes = start.bytes + sizeof(BlockHeader) + records.size() * bytesPerRow(extraColumns);
+    grown.extraColumns = extraColumns;
+    return true;
+}
+
+bool Segment::commit(const std::string& path, std::uint64_t appendedFrom, const Extent& extent) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    SegmentHeader header;
+    if (!file.is_open() || !readHeader(file, header)) {
+        return false;
+    }
+
+    // Committed before (a repeated replay) or still ending where the block starts
+    if (header.byteSize != appendedFrom && header.byteSize != extent.bytes) {
+        return false;
+    }
+    std::error_code error;
+    if (std::filesystem::file_size(path, error) < extent.bytes || error) {
+        return false;
+    }
+
+    // The journal does not repeat the layout; keep the segment's own
+    Extent committed = extent;
+    committed.extraColumns = header.extraCount;
+    header = makeHeader(committed);
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    return !file.fail();
+}
+
+bool Segment::recover(const std::string& path, Extent& extent) {
+    SegmentHeader header;
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!readHeader(in, header)) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::uint64_t fileSize = std::filesystem::file_size(path, error);
+    if (error || fileSize < header.byteSize) {
+        return false;
+    }
+    if (fileSize > header.byteSize) {
+        std::filesystem::resize_file(path, header.byteSize, error);
+        if (error) return false;
+    }
+
+    extent.rows = header.rowCount;
+    extent.bytes = header.byteSize;
+    extent.blocks = header.blockCount;
+    extent.extraColumns = header.extraCount;
+    return true;
+}
+
+// SegmentStore implementation
+SegmentStore::SegmentStore()
+    : directory(), extraColumns(), memoryBudget(0), residentBytes(0), entries(), lru(), residency(),
+      ingestedOffsets(), yearRows(), monthRows(), partitionCount(0), totalRows(0), isOpenFlag(false) {}
+
+bool SegmentStore::open(const std::string& storeDirectory, std::size_t budget,
+                        const std::vector<std::string>& columns) {
+    close();
+
+    std::error_code error;
+    std::filesystem::create_directories(storeDirectory, error);
+    if (!std::filesystem::is_directory(storeDirectory, error)) {
+        return false;
+    }
+
+    directory = storeDirectory;
+    memoryBudget = budget;
+
+    std::ifstream manifest(manifestPath());
+    std::string line;
+    while (std::getline(manifest, line)) {
+        std::size_t tab = line.find('\t');
+        std::size_t offset = 0;
+        if (tab == std::string::npos ||
+            std::from_chars(line.data(), line.data() + tab, offset).ec != std::errc()) {
+            continue;
+        }
+        ingestedOffsets.insert(line.substr(tab + 1), offset);
+    }
+    manifest.close();
+
+    // Finish a load that committed but was interrupted before its segment
+    // headers and manifest were updated, then drop anything staged by a load
+    // that never committed (recover() cuts off its appended blocks)
+    if (!replayJournal()) {
+        std::cerr << "Error: Could not finish the interrupted load recorded in " << journalPath() << std::endl;
+        directory.clear();
+        ingestedOffsets = Map<std::string, std::size_t, HashBackend<std::string, std::size_t>>();
+        return false;
+    }
+    for (const std::filesystem::directory_entry& item : std::filesystem::directory_iterator(storeDirectory, error)) {
+        if (item.is_regular_file(error) && endsWith(item.path().filename().string(), STAGED_SUFFIX)) {
+            std::filesystem::remove(item.path(), error);
+        }
+    }
+
+    // The extra columns are fixed once the store holds rows (any stored row
+    // was committed with its file's offset in the manifest)
+    std::vector<std::string> storedColumns;
+    std::ifstream columnList(columnsPath());
+    while (std::getline(columnList, line)) {
+        if (!line.empty()) storedColumns.push_back(line);
+    }
+    columnList.close();
+    if (storedColumns != columns) {
+        if (!ingestedOffsets.empty()) {
+            std::cerr << "Error: The segment store keeps other extra columns than those asked for; see "
+                      << columnsPath() << std::endl;
+            close();
+            return false;
+        }
+        std::ofstream out(columnsPath() + STAGED_SUFFIX, std::ios::trunc);
+        for (const std::string& column : columns) {
+            out << column << '\n';
+        }
+        out.close();
+        if (out.fail() || !moveIntoPlace(columnsPath())) {
+            close();
+            return false;
+        }
+    }
+
+    for (const std::filesystem::directory_entry& item : std::filesystem::directory_iterator(storeDirectory, error)) {
+        int key = 0;
+        Segment::Extent extent;
+        if (!item.is_regular_file(error) || !parseSegmentName(item.path().filename().string(), key)) {
+            continue;
+        }
+        if (!Segment::recover(item.path().string(), extent) || extent.extraColumns != columns.size()) {
+            std::cerr << "Warning: Ignoring unreadable segment " << item.path().string() << std::endl;
+            continue;
+        }
+        setExtent(key, extent);
+    }
+    extraColumns = columns;
+
+    isOpenFlag = true;
+    return true;
+}
+
+void SegmentStore::close() {
+    std::lock_guard<std::mutex> lock(residency);
+    lru.clear();
+    entries = Map<int, Entry, FlatBackend<int, Entry>>();
+    ingestedOffsets = Map<std::string, std::size_t, HashBackend<std::string, std::size_t>>();
+    yearRows = Map<int, std::size_t, FlatBackend<int, std::size_t>>();
+    monthRows.fill(0);
+    partitionCount = 0;
+    totalRows = 0;
+    residentBytes = 0;
+    directory.clear();
+    extraColumns.clear();
+    isOpenFlag = false;
+}
+
+bool SegmentStore::isOpen() const { return isOpenFlag; }
+
+const std::string& SegmentStore::getDirectory() const { return directory; }
+
+void SegmentStore::setMemoryBudget(std::size_t bytes) {
+    std::lock_guard<std::mutex> lock(residency);
+    memoryBudget = bytes;
+    evictOver(-1);
+}
+
+std::size_t SegmentStore::getMemoryBudget() const { return memoryBudget; }
+
+std::size_t SegmentStore::getResidentBytes() const { return residentBytes; }
+
+std::size_t SegmentStore::getResidentSegments() const { return lru.size(); }
+
+std::size_t SegmentStore::getPartitionCount() const { return partitionCount; }
+
+std::size_t SegmentStore::getRowCount(int key) const {
+    const Entry* entry = entries.find(key);
+    return entry != nullptr ? static_cast<std::size_t>(entry->committed.rows) : 0;
+}
+
+std::size_t SegmentStore::getMonthRowCount(int month) const {
+    return (month >= 1 && month <= 12) ? monthRows[month - 1] : 0;
+}
+
+std::size_t SegmentStore::getYearRowCount(int year) const {
+    const std::size_t* rows = yearRows.find(year);
+    return rows != nullptr ? *rows : 0;
+}
+
+std::vector<int> SegmentStore::getYears() const {
+    std::vector<int> years;
+    for (const auto& entry : yearRows) {
+        if (entry.second > 0) years.push_back(entry.first);
+    }
+    return years;
+}
+
+std::size_t SegmentStore::getTotalRows() const { return totalRows; }
+
+void SegmentStore::setExtent(int key, const Segment::Extent& extent) {
+    Segment::Extent& committed = entries.findOrInsert(key).committed;
+    std::size_t rows = static_cast<std::size_t>(extent.rows);
+    std::size_t stored = static_cast<std::size_t>(committed.rows);
+    if (stored == 0 && rows > 0) partitionCount++;
+    if (stored > 0 && rows == 0) partitionCount--;
+
+    // Unsigned wrap-around makes these subtract when a count shrinks
+    yearRows.findOrInsert(yearOfKey(key)) += rows - stored;
+    monthRows[monthOfKey(key) - 1] += rows - stored;
+    totalRows += rows - stored;
+    committed = extent;
+}
+std::shared_ptr<const Segment> SegmentStore::acquire(int key) {
+    std::lock_guard<std::mutex> lock(residency);
+    Entry* entry = entries.find(key);
+    if (entry == nullptr || entry->committed.rows == 0) {
+        return nullptr;
+    }
+
+    if (entry->resident) {
+        lru.splice(lru.begin(), lru, entry->lruPosition);
+        return entry->resident;
+    }
+
+    std::shared_ptr<Segment> segment = std::make_shared<Segment>();
+    if (!segment->open(segmentPath(key))) {
+        std::cerr << "Error: Could not map segment " << segmentPath(key) << std::endl;
+        return nullptr;
+    }
+
+    entry->resident = segment;
+    lru.push_front(key);
+    entry->lruPosition = lru.begin();
+    residentBytes += segment->mappedBytes();
+
+    evictOver(key);
+    return segment;
+}
+
+// Unmap least recently used segments until the budget is met. The segment
+// being handed out (keepKey) is never evicted, even if it alone is over budget.
+void SegmentStore::evictOver(int keepKey) {
+    while (residentBytes > memoryBudget && !lru.empty() && lru.back() != keepKey) {
+        release(lru.back());
+    }
+}
+
+void SegmentStore::release(int key) {
+    Entry* entry = entries.find(key);
+    if (entry == nullptr || !entry->resident) {
+        return;
+    }
+    residentBytes -= entry->resident->mappedBytes();
+    lru.erase(entry->lruPosition);
+    entry->resident.reset();
+}
+
+bool SegmentStore::append(const std::vector<WeatherRecord>& records, const std::vector<double>& extraValues,
+                          const std::string& filename, std::size_t endOffset) {
+    std::uint32_t extraCount = static_cast<std::uint32_t>(extraColumns.size());
+    if (extraValues.size() != records.size() * extraCount) {
+        return false;
+    }
+
+    // Group by partition, keeping load order within each
+    Map<int, std::vector<std::size_t>> byPartition;
+    for (std::size_t row = 0; row < records.size(); row++) {
+        Date date = records[row].timestamp.GetDate();
+        byPartition.findOrInsert(partitionKey(date.GetYear(), date.GetMonth())).push_back(row);
+    }
+
+    // Write each partition's rows past its segment's committed end (or stage
+    // a rewrite). Until the journal exists the headers still describe the
+    // old extents, so a failure (or a crash) here leaves the store as it was.
+    std::vector<std::string> journal;
+    std::vector<std::string> staged;
+    std::vector<std::pair<int, Segment::Extent>> grownExtents, oldExtents;
+    bool allWritten = true;
+    for (auto& partition : byPartition) {
+        int key = partition.first;
+        std::string path = segmentPath(key);
+        std::string name = std::filesystem::path(path).filename().string();
+
+        std::vector<WeatherRecord> newRecords;
+        std::vector<double> newValues;
+        newRecords.reserve(partition.second.size());
+        newValues.reserve(partition.second.size() * extraCount);
+        for (std::size_t row : partition.second) {
+            newRecords.push_back(records[row]);
+            newValues.insert(newValues.end(), extraValues.begin() + row * extraCount,
+                             extraValues.begin() + (row + 1) * extraCount);
+        }
+        // Files arrive in time order, so this is normally sorted already
+        sortRows(newRecords, newValues, extraCount);
+
+        const Entry* entry = entries.find(key);
+        Segment::Extent committed = (entry != nullptr) ? entry->committed : Segment::Extent();
+        std::shared_ptr<const Segment> existing;
+        if (committed.rows > 0) {
+            existing = acquire(key);
+            if (existing == nullptr) {
+                allWritten = false;
+                break;
+            }
+        }
+
+        Segment::Extent grown;
+        if (existing == nullptr || !(newRecords.front().timestamp < existing->lastTimestamp())) {
+            if (!Segment::appendBlock(path, committed, newRecords, newValues, extraCount, grown)) {
+                std::cerr << "Error: Could not append to segment " << path << std::endl;
+                allWritten = false;
+                break;
+            }
+            std::uint64_t from = (committed.bytes > 0) ? committed.bytes : sizeof(SegmentHeader);
+            oldExtents.emplace_back(key, committed);
+            journal.push_back("append\t" + std::to_string(from) + '\t' + std::to_string(grown.bytes) + '\t' +
+                              std::to_string(grown.rows) + '\t' + std::to_string(grown.blocks) + '\t' + name);
+        } else {
+            // Rows earlier than the segment's last one (files loaded out of
+            // time order): rewrite the month in time order under a staged name
+            std::vector<WeatherRecord> merged;
+            std::vector<double> mergedValues;
+            merged.reserve(existing->size() + newRecords.size());
+            mergedValues.reserve((existing->size() + newRecords.size()) * extraCount);
+            for (std::size_t index = 0; index < existing->blockCount(); index++) {
+                RecordSlice slice = existing->block(index);
+                for (std::size_t row = 0; row < slice.size; row++) {
+                    merged.push_back(slice.recordAt(row));
+                    for (std::size_t column = 0; column < extraCount; column++) {
+                        mergedValues.push_back(slice.extraAt(row, column));
+                    }
+                }
+            }
+            merged.insert(merged.end(), newRecords.begin(), newRecords.end());
+            mergedValues.insert(mergedValues.end(), newValues.begin(), newValues.end());
+            sortRows(merged, mergedValues, extraCount);
+
+            if (!Segment::write(path + STAGED_SUFFIX, merged, mergedValues, extraCount, grown)) {
+                std::cerr << "Error: Could not write segment " << path << STAGED_SUFFIX << std::endl;
+                allWritten = false;
+                break;
+            }
+            staged.push_back(path + STAGED_SUFFIX);
+            journal.push_back("replace\t" + name);
+        }
+        grownExtents.emplace_back(key, grown);
+    }
+    journal.push_back("ingested\t" + std::to_string(endOffset) + '\t' + filename);
+
+    if (!allWritten || !writeJournal(journal)) {
+        // Not committed: drop the staged files and the blocks written past the old ends
+        for (const std::string& path : staged) {
+            std::remove(path.c_str());
+        }
+        for (const std::pair<int, Segment::Extent>& old : oldExtents) {
+            std::error_code error;
+            if (old.second.bytes == 0) {
+                std::remove(segmentPath(old.first).c_str());
+            } else {
+                std::filesystem::resize_file(segmentPath(old.first), old.second.bytes, error);
+            }
+        }
+        return false;
+    }
+
+    // Committed: the rows and the offset they end at are now stored together.
+    // Mapped copies of the grown segments are dropped so the next acquire()
+    // sees the new rows; queries still holding one keep the old extent.
+    for (const std::pair<int, Segment::Extent>& grown : grownExtents) {
+        setExtent(grown.first, grown.second);
+        std::lock_guard<std::mutex> lock(residency);
+        release(grown.first);
+    }
+    if (!replayJournal()) {
+        std::cerr << "Warning: Could not record every segment of this load; reopen "
+                  << directory << " to finish" << std::endl;
+    }
+    return true;
+}
+
+const std::size_t* SegmentStore::findIngestedOffset(const std::string& filename) const {
+    return ingestedOffsets.find(filename);
+}
+
+// Manifest lines are "<offset>\t<file name>"
+bool SegmentStore::writeManifest(const std::string& path,
+                                 const Map<std::string, std::size_t, HashBackend<std::string, std::size_t>>& offsets) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    for (const auto& entry : offsets) {
+        out << entry.second << '\t' << entry.first << '\n';
+    }
+    out.close();
+    if (out.fail()) {
+        std::remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The journal lists what one load changed, one tab-separated line each:
+//   append <from> <to> <rows> <blocks> <segment>  block written at bytes [from, to) of the segment,
+//                                                 and the segment's extent with it
+//   replace <segment>                             a rewritten segment staged next to it
+//   ingested <offset> <data file>                 how far into the data file the load read
+// It is itself staged and renamed, so it appears complete or not at all.
+bool SegmentStore::writeJournal(const std::vector<std::string>& lines) const {
+    std::string path = journalPath();
+    {
+        std::ofstream out(path + STAGED_SUFFIX, std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        for (const std::string& line : lines) {
+            out << line << '\n';
+        }
+        out.close();
+        if (out.fail()) {
+            std::remove((path + STAGED_SUFFIX).c_str());
+            return false;
+        }
+    }
+    return moveIntoPlace(path);
+}
+
+// Apply every line of the journal, then remove it. Each step can be repeated,
+// so a crash part-way through is finished by the next replay.
+bool SegmentStore::replayJournal() {
+    std::string path = journalPath();
+    std::ifstream journal(path);
+    if (!journal.is_open()) {
+        return true; // nothing pending
+    }
+
+    bool allApplied = true;
+    bool offsetsChanged = false;
+    std::string line;
+    while (std::getline(journal, line)) {
+        std::vector<std::string> fields;
+        for (std::size_t start = 0, tab = 0; tab != std::string::npos; start = tab + 1) {
+            tab = line.find('\t', start);
+            fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        }
+
+        Segment::Extent extent;
+        std::uint64_t from = 0;
+        std::size_t offset = 0;
+        if (fields[0] == "append" && fields.size() == 6 && parseNumber(fields[1], from) &&
+            parseNumber(fields[2], extent.bytes) && parseNumber(fields[3], extent.rows) &&
+            parseNumber(fields[4], extent.blocks)) {
+            if (!Segment::commit(directory + "/" + fields[5], from, extent)) allApplied = false;
+        } else if (fields[0] == "replace" && fields.size() == 2) {
+            if (!moveIntoPlace(directory + "/" + fields[1])) allApplied = false;
+        } else if (fields[0] == "ingested" && fields.size() == 3 && parseNumber(fields[1], offset)) {
+            ingestedOffsets.insert(fields[2], offset);
+            offsetsChanged = true;
+        } else if (!line.empty()) {
+            allApplied = false;
+        }
+    }
+    journal.close();
+
+    if (offsetsChanged) {
+        if (!writeManifest(manifestPath() + STAGED_SUFFIX, ingestedOffsets) || !moveIntoPlace(manifestPath())) {
+            allApplied = false;
+        }
+    }
+    return allApplied && std::remove(path.c_str()) == 0;
+}
+
+std::string SegmentStore::segmentPath(int key) const {
+    int month = monthOfKey(key);
+    return directory + "/" + std::to_string(yearOfKey(key)) + (month < 10 ? "-0" : "-") + std::to_string(month)
+           + SEGMENT_EXTENSION;
+}
+
+std::string SegmentStore::manifestPath() const {
+    return directory + "/" + MANIFEST_NAME;
+}
+
+std::string SegmentStore::columnsPath() const {
+    return directory + "/" + COLUMNS_NAME;
+}
+
+std::string SegmentStore::journalPath() const {
+    return directory + "/" + JOURNAL_NAME;
+}
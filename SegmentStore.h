@@ -0,0 +1,198 @@
+#ifndef SEGMENTSTORE_H
+#define SEGMENTSTORE_H
+
+#include "DateTime.h"
+#include "Map.h"
+#include "MappedFile.h"
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class WeatherRecord;
+struct RecordSlice;
+
+/// @class Segment
+/// @brief One (year, month) segment file, memory-mapped
+///
+/// Layout (native byte order, every section 8-byte aligned):
+///   header | block | block | ...
+///   block: rowCount (uint64) | timestamp[n] (int64 minutes since 1/1/1970) |
+///          windSpeed[n] | temperature[n] | solarRadiation[n] | extra column 0[n] | ...
+///
+/// The header gives the number of extra columns, the same in every block.
+///
+/// Each load that adds rows to the month appends one block at the tail, so
+/// the rows already stored are never read or rewritten. The header records
+/// the committed extent (rows, blocks and bytes); bytes past it belong to an
+/// append that was never committed and are ignored, then cut off by recover().
+/// Rows are in time order, across blocks as well as within them.
+class Segment {
+public:
+    // 2: appended blocks replace one set of columns; 3: extra columns
+    static const std::uint32_t VERSION = 3;
+
+    /// The part of a segment file its header commits
+    struct Extent {
+        std::uint64_t rows = 0;
+        std::uint64_t bytes = 0; // file length up to the end of the last committed block
+        std::uint32_t blocks = 0;
+        std::uint32_t extraColumns = 0;
+    };
+
+    Segment();
+
+    /// Map the segment at path and check its header and blocks.
+    bool open(const std::string& path);
+
+    std::size_t size() const;
+    std::size_t mappedBytes() const;
+    std::size_t extraColumnCount() const;
+
+    // Blocks, in time order (valid while the segment is open)
+    std::size_t blockCount() const;
+    RecordSlice block(std::size_t index) const;
+    DateTime lastTimestamp() const; // of a segment with rows
+
+    /// Write records (already in time order), each with extraColumns values
+    /// from extraValues, as a segment of one block at path. SegmentStore
+    /// writes to a staged name and renames it into place.
+    static bool write(const std::string& path, const std::vector<WeatherRecord>& records,
+                      const std::vector<double>& extraValues, std::uint32_t extraColumns, Extent& written);
+
+    /// Write records the same way as a new block at the end of committed,
+    /// creating the file if committed is empty. The block is not part of the
+    /// segment until commit() records grown in the header.
+    static bool appendBlock(const std::string& path, const Extent& committed,
+                            const std::vector<WeatherRecord>& records, const std::vector<double>& extraValues,
+                            std::uint32_t extraColumns, Extent& grown);
+
+    /// Record extent in the header of the segment at path, whose last block
+    /// was appended at byte appendedFrom. Repeating it is harmless.
+    static bool commit(const std::string& path, std::uint64_t appendedFrom, const Extent& extent);
+
+    /// Read the committed extent from the header, cutting off any bytes an
+    /// uncommitted append left past it.
+    static bool recover(const std::string& path, Extent& extent);
+
+private:
+    MappedFile file;
+    std::size_t rowCount;
+    std::size_t extraCount;
+    std::vector<std::uint64_t> blockOffsets; // file offset of each block
+};
+
+/// @class SegmentStore
+/// @brief Out-of-core weather data: a directory of per-(year, month) segment files
+///
+/// Segments are mapped on first use and kept in least-recently-used order.
+/// When the mapped bytes exceed the memory budget the coldest segments are
+/// unmapped, so resident memory stays bounded whatever the archive size.
+/// acquire() hands out shared ownership: a segment evicted while a query
+/// still holds it stays mapped until that query lets go of it. Several
+/// threads may acquire() at once; loading (append) is single-threaded.
+///
+/// The store also remembers how many bytes of each data file have been
+/// ingested (ingested.txt), so loading the same files again only adds rows
+/// appended since. A file's rows and its new offset are committed together
+/// (see append), so an interrupted load never stores the same rows twice.
+///
+/// Every segment of a store holds the same extra columns, listed in
+/// columns.txt; a store can only be reopened with the same ones.
+class SegmentStore {
+public:
+    SegmentStore();
+
+    /// Open (creating if needed) the store in directory and index its segments.
+    /// extraColumns names the columns stored besides S, T and SR.
+    bool open(const std::string& directory, std::size_t memoryBudget,
+              const std::vector<std::string>& extraColumns = {});
+    void close();
+    bool isOpen() const;
+    const std::string& getDirectory() const;
+
+    void setMemoryBudget(std::size_t bytes);
+    std::size_t getMemoryBudget() const;
+    std::size_t getResidentBytes() const;
+    std::size_t getResidentSegments() const;
+
+    // Partition keys; year * 12 + month - 1, so keys sort chronologically
+    static int partitionKey(int year, int month) { return year * 12 + (month - 1); }
+    static int yearOfKey(int key) { return key / 12; }
+    static int monthOfKey(int key) { return key % 12 + 1; }
+
+    /// Call visit(key, rows) for each partition with rows, in ascending key order.
+    template <class Visitor>
+    void forEachPartition(Visitor&& visit) const;
+
+    // Row counts, kept up to date by open() and append() rather than summed on each call
+    std::size_t getPartitionCount() const; // partitions with rows
+    std::size_t getRowCount(int key) const;
+    std::size_t getMonthRowCount(int month) const; // month 1-12 of every year
+    std::size_t getYearRowCount(int year) const;
+    std::vector<int> getYears() const; // years with rows, ascending
+    std::size_t getTotalRows() const;
+
+    /// The segment for key, mapping it if needed; nullptr if there is none.
+    std::shared_ptr<const Segment> acquire(int key);
+
+    /// Add records read from filename up to endOffset, with the values of the
+    /// extra columns, record by record, in extraValues. Each segment that
+    /// gains rows gets them as a block at its tail (or, if they are earlier
+    /// than its last row, is rewritten in time order under a staged name).
+    /// One journal of the new byte ranges and offset commits them together,
+    /// so on false (or after a crash before the commit) the store is unchanged.
+    bool append(const std::vector<WeatherRecord>& records, const std::vector<double>& extraValues,
+                const std::string& filename, std::size_t endOffset);
+
+    // Bytes of each data file already stored
+    const std::size_t* findIngestedOffset(const std::string& filename) const;
+
+private:
+    struct Entry {
+        Segment::Extent committed;
+        std::shared_ptr<Segment> resident;   // null when not mapped
+        std::list<int>::iterator lruPosition; // valid while resident
+    };
+
+    std::string directory;
+    std::vector<std::string> extraColumns;
+    std::size_t memoryBudget;
+    std::size_t residentBytes;
+    Map<int, Entry, FlatBackend<int, Entry>> entries;
+    std::list<int> lru; // resident keys, most recently used first
+    std::mutex residency; // guards resident, lru and residentBytes
+    Map<std::string, std::size_t, HashBackend<std::string, std::size_t>> ingestedOffsets;
+    Map<int, std::size_t, FlatBackend<int, std::size_t>> yearRows;
+    std::array<std::size_t, 12> monthRows; // by month of the year, summed over years
+    std::size_t partitionCount;
+    std::size_t totalRows;
+    bool isOpenFlag;
+
+    void setExtent(int key, const Segment::Extent& extent); // and adjust the row totals
+    std::string segmentPath(int key) const;
+    std::string manifestPath() const;
+    std::string columnsPath() const;
+    std::string journalPath() const;
+    void release(int key);      // call with residency locked
+    void evictOver(int keepKey); // call with residency locked
+    static bool writeManifest(const std::string& path,
+                              const Map<std::string, std::size_t, HashBackend<std::string, std::size_t>>& offsets);
+    bool writeJournal(const std::vector<std::string>& lines) const;
+    bool replayJournal();
+};
+
+// Template implementation
+
+template <class Visitor>
+void SegmentStore::forEachPartition(Visitor&& visit) const {
+    for (const auto& entry : entries) {
+        std::uint64_t rows = entry.second.committed.rows;
+        if (rows > 0) visit(entry.first, static_cast<std::size_t>(rows));
+    }
+}
+
+#endif // SEGMENTSTORE_H
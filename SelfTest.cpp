@@ -0,0 +1,1342 @@
+#include "SelfTest.h"
+#include "Bst.h"
+#include "Map.h"
+#include "MetDataParser.h"
+#include "StatKernels.h"
+#include "WeatherData.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char* const HEADER = "WAST,DP,Dta,Dts,EV,QFE,QFF,QNH,RF,RH,S,SR,T,ST1,ST2,ST3,ST4,Sx";
+
+    // A MetData row for day/03/2016 hour:minute with the given S, SR and T
+    std::string dataRow(int day, int hour, int minute, double windSpeed, double solarRadiation, double temperature) {
+        std::ostringstream row;
+        row << (day < 10 ? "0" : "") << day << "/03/2016 " << hour << ':' << (minute < 10 ? "0" : "") << minute
+            << ",12.2,221,34,0,1013.4,1016.9,1017,0,68.2," << windSpeed << ',' << solarRadiation << ','
+            << temperature << ",22.7,24.1,25.5,26.1,8";
+        return row.str();
+    }
+
+    // A MetData row for day/03/2016 hour:minute; the wind speed (S) is minute / 10
+    std::string dataRow(int day, int hour, int minute) {
+        return dataRow(day, hour, minute, minute / 10, 512, 20.74);
+    }
+
+    void appendText(const std::filesystem::path& path, const std::string& text) {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << text;
+    }
+
+    /// Sends std::cout and std::cerr nowhere while the code under test reports progress
+    class QuietOutput {
+    private:
+        std::ostringstream sink;
+        std::streambuf* savedOut;
+        std::streambuf* savedErr;
+
+    public:
+        QuietOutput() : sink(), savedOut(std::cout.rdbuf(sink.rdbuf())), savedErr(std::cerr.rdbuf(sink.rdbuf())) {}
+        ~QuietOutput() {
+            std::cout.rdbuf(savedOut);
+            std::cerr.rdbuf(savedErr);
+        }
+    };
+
+    /// An empty directory under the system temporary directory, removed again afterwards
+    class ScratchDirectory {
+    private:
+        std::filesystem::path root;
+
+    public:
+        explicit ScratchDirectory(const std::string& name)
+            : root(std::filesystem::temp_directory_path() / ("ict283-selftest-" + name)) {
+            std::filesystem::remove_all(root);
+            std::filesystem::create_directories(root);
+        }
+        ~ScratchDirectory() {
+            std::error_code error;
+            std::filesystem::remove_all(root, error);
+        }
+
+        std::filesystem::path operator/(const std::string& name) const { return root / name; }
+    };
+
+    bool report(const std::string& name, bool passed, const std::string& detail) {
+        std::cout << (passed ? "PASS: " : "FAIL: ") << name << " (" << detail << ")" << std::endl;
+        return passed;
+    }
+
+    // A header line and a row for 31/03/2016 9:00 with S = 4.5, SR = 512 and
+    // T = 20.75 placed in the columns the header names
+    struct HeaderCase {
+        const char* name;
+        const char* header;
+        const char* row;
+    };
+
+    const HeaderCase HEADER_CASES[] = {
+        {"standard", "WAST,DP,Dta,Dts,EV,QFE,QFF,QNH,RF,RH,S,SR,T,ST1,ST2,ST3,ST4,Sx",
+         "31/03/2016 9:00,12.2,221,34,0,1013.4,1016.9,1017,0,68.2,4.5,512,20.75,22.7,24.1,25.5,26.1,8"},
+        {"reordered", "T,SR,WAST,S", "20.75,512,31/03/2016 9:00,4.5"},
+        {"extra and padded", "Id, WAST ,Note,\tS, SR ,RH,T ,Sx", "7,31/03/2016 9:00,ok,4.5,512,68.2,20.75,8"},
+        {"Date label", "Date,S,SR,T", "31/03/2016 9:00,4.5,512,20.75"},
+        {"repeated name", "WAST,S,S,SR,T", "31/03/2016 9:00,4.5,9.5,512,20.75"},
+    };
+
+    bool checkHeaderCase(const HeaderCase& test, std::ostringstream& detail) {
+        MetDataParser parser;
+        WeatherRecord record(DateTime(), 0.0, 0.0, 0.0);
+        if (!parser.readHeader(test.header)) {
+            detail << test.name << ": header rejected for '" << parser.getMissingColumn() << "'; ";
+            return false;
+        }
+        if (!parser.parseRecord(test.row, record)) {
+            detail << test.name << ": row rejected; ";
+            return false;
+        }
+
+        bool matches = record.timestamp == DateTime(Date(31, 3, 2016), 9, 0) && record.windSpeed == 4.5 &&
+                       record.solarRadiation == 512 && record.temperature == 20.75;
+        if (!matches) {
+            detail << test.name << ": read " << record << "; ";
+        }
+        return matches;
+    }
+
+    // Load a file whose last row is cut off mid-line, finish that row and add
+    // one more, then refresh
+    bool checkFollowMode(const std::string& name, bool outOfCore) {
+        ScratchDirectory scratch(name);
+        std::filesystem::path dataFile = scratch / "MetData.csv";
+        std::filesystem::path sourceFile = scratch / "source.txt";
+        std::filesystem::path storeDirectory = scratch / "segments";
+
+        appendText(sourceFile, dataFile.string() + "\n");
+        std::string cutRow = dataRow(30, 17, 10);
+        std::size_t cut = cutRow.size() / 2;
+        appendText(dataFile, std::string(HEADER) + "\n" + dataRow(28, 16, 50) + "\n" + dataRow(29, 17, 0) + "\n" +
+                                 cutRow.substr(0, cut));
+
+        int loaded = 0, total = 0, reopened = -1;
+        long long added = 0;
+        bool cutRowFound = false;
+        {
+            QuietOutput quiet;
+            WeatherDataCollection collection;
+            collection.setSnapshotEnabled(false);
+            if (outOfCore) collection.openSegmentStore(storeDirectory.string(), 1 << 20);
+
+            collection.loadFromFiles(sourceFile.string());
+            loaded = collection.getTotalRecords();
+
+            appendText(dataFile, cutRow.substr(cut) + "\n" + dataRow(31, 17, 20) + "\n");
+            added = collection.refreshFromFiles();
+            total = collection.getTotalRecords();
+
+            for (const WeatherRecord& record : collection.getDataForYearMonth(2016, 3)) {
+                if (record.timestamp == DateTime(Date(30, 3, 2016), 17, 10) && record.windSpeed == 1.0) {
+                    cutRowFound = true;
+                }
+            }
+
+            if (outOfCore) {
+                WeatherDataCollection again;
+                again.openSegmentStore(storeDirectory.string(), 1 << 20);
+                again.loadFromFiles(sourceFile.string());
+                reopened = again.getTotalRecords();
+            }
+        }
+
+        std::ostringstream detail;
+        detail << "loaded " << loaded << " of 2, refresh added " << added << " of 2, total " << total << " of 4";
+        if (outOfCore) detail << ", reopened store " << reopened << " of 4";
+        detail << (cutRowFound ? ", cut row intact" : ", cut row missing");
+
+        bool passed = loaded == 2 && added == 2 && total == 4 && cutRowFound && (!outOfCore || reopened == 4);
+        return report(name, passed, detail.str());
+    }
+
+    // Every ten minutes of March 2016 with scattered values, some repeated
+    std::string monthOfRows() {
+        std::string rows = std::string(HEADER) + "\n";
+        std::uint32_t state = 12345;
+        for (int day = 1; day <= 31; day++) {
+            for (int minutes = 0; minutes < 24 * 60; minutes += 10) {
+                state = state * 1664525u + 1013904223u;
+                int windSpeed = static_cast<int>(state >> 27);      // 0-31 km/h, many ties
+                double temperature = (state >> 8) % 4000 / 100.0;    // 0.00-39.99
+                int solarRadiation = static_cast<int>((state >> 4) % 1100);
+                rows += dataRow(day, minutes / 60, minutes % 60, windSpeed, solarRadiation, temperature) + "\n";
+            }
+        }
+        return rows;
+    }
+
+    // The percentiles of a month against the exact ranks of its values: each
+    // must lie within the sketches' rank error of where it was asked for.
+    bool checkPercentiles(const std::string& name, bool outOfCore) {
+        ScratchDirectory scratch(name);
+        std::filesystem::path dataFile = scratch / "MetData.csv";
+        std::filesystem::path sourceFile = scratch / "source.txt";
+        appendText(sourceFile, dataFile.string() + "\n");
+        appendText(dataFile, monthOfRows());
+
+        const MeasuredField fields[] = {MeasuredField::WindSpeed, MeasuredField::Temperature,
+                                        MeasuredField::SolarRadiation};
+        const double fractions[] = {0.05, 0.5, 0.95};
+        double rankError = Statistics::QuantileSketch().getRankError();
+        double worst = 0.0;
+        std::size_t count = 0;
+        {
+            QuietOutput quiet;
+            WeatherDataCollection collection;
+            collection.setSnapshotEnabled(false);
+            if (outOfCore) collection.openSegmentStore((scratch / "segments").string(), 1 << 20);
+            collection.loadFromFiles(sourceFile.string());
+
+            std::vector<WeatherRecord> records = collection.getDataForMonth(3);
+            count = records.size();
+            for (MeasuredField field : fields) {
+                std::vector<double> values;
+                for (const WeatherRecord& record : records) {
+                    values.push_back(field == MeasuredField::WindSpeed     ? record.windSpeed
+                                     : field == MeasuredField::Temperature ? record.temperature
+                                                                           : record.solarRadiation);
+                }
+                std::sort(values.begin(), values.end());
+
+                for (double fraction : fractions) {
+                    // Ranks the answer occupies in the sorted values, [below, upTo)
+                    double answer = fraction == 0.5 ? collection.getMonthlyMedian(3, field)
+                                                    : collection.getMonthlyPercentile(3, field, fraction);
+                    double below = std::lower_bound(values.begin(), values.end(), answer) - values.begin();
+                    double upTo = std::upper_bound(values.begin(), values.end(), answer) - values.begin();
+                    double wanted = fraction * values.size();
+                    double off = (wanted < below) ? below - wanted : (wanted > upTo ? wanted - upTo : 0.0);
+                    worst = std::max(worst, off / values.size());
+                }
+            }
+        }
+
+        std::ostringstream detail;
+        detail << count << " rows, worst rank error " << worst * 100 << "% of " << rankError * 100 << "% allowed";
+        return report(name, count == 31 * 144 && worst <= rankError, detail.str());
+    }
+
+    // A year of rows every 6 hours from shift minutes past midnight, with S
+    // numbering the row, appended to path; (minutes since epoch, S) of each
+    // row goes into written
+    void writeYearOfRows(const std::filesystem::path& path, int year,
+                         std::vector<std::pair<std::int64_t, double>>& written, int shift = 0) {
+        std::string rows = std::string(HEADER) + "\n";
+        std::int64_t first = DateTime(Date(1, 1, year)).GetMinutesSinceEpoch() + shift;
+        std::int64_t last = DateTime(Date(1, 1, year + 1)).GetMinutesSinceEpoch();
+        for (std::int64_t minutes = first; minutes < last; minutes += 6 * 60) {
+            double windSpeed = static_cast<double>(written.size());
+            char text[32];
+            char* end = DateTime::fromMinutes(minutes).format(text, text + sizeof(text));
+            std::ostringstream row;
+            row << std::string(text, end) << ",12.2,221,34,0,1013.4,1016.9,1017,0,68.2," << windSpeed
+                << ",512,20.74,22.7,24.1,25.5,26.1,8\n";
+            rows += row.str();
+            written.emplace_back(minutes, windSpeed);
+        }
+        appendText(path, rows);
+    }
+
+    // getDataForMonth and the month's view for every month against the rows
+    // written with that month, over two years loaded latest first and then
+    // rows of the earlier year between those already loaded: from the CSV
+    // files, again from the snapshot that load wrote, out of core, and from
+    // the segment store reopened with nothing loaded. Each month of a year
+    // must come back in time order.
+    bool checkMonthQueries() {
+        ScratchDirectory scratch("month-queries");
+        std::filesystem::path sourceFile = scratch / "source.txt";
+        std::vector<std::pair<std::int64_t, double>> written;
+        const std::pair<int, int> files[] = {{2017, 0}, {2016, 0}, {2016, 3 * 60}};
+        for (const std::pair<int, int>& file : files) {
+            std::filesystem::path dataFile =
+                scratch / ("MetData_" + std::to_string(file.first) + "_" + std::to_string(file.second) + ".csv");
+            writeYearOfRows(dataFile, file.first, written, file.second);
+            appendText(sourceFile, dataFile.string() + "\n");
+        }
+
+        const char* const loads[] = {"files", "snapshot", "segments", "reopened segments"};
+        int wrongMonths = 0;
+        std::ostringstream detail;
+        for (int load = 0; load < 4; load++) {
+            QuietOutput quiet;
+            WeatherDataCollection collection;
+            if (load >= 2) collection.openSegmentStore((scratch / "segments").string(), 1 << 20);
+            if (load < 3) collection.loadFromFiles(sourceFile.string());
+
+            if (collection.getAvailableYears() != std::vector<int>{2016, 2017} ||
+                collection.getTotalRecords() != static_cast<int>(written.size())) {
+                wrongMonths++;
+                detail << loads[load] << " years or total wrong, ";
+            }
+
+            for (int month = 1; month <= 12; month++) {
+                std::vector<std::pair<std::int64_t, double>> expected, found;
+                for (const std::pair<std::int64_t, double>& row : written) {
+                    if (DateTime::fromMinutes(row.first).GetMonth() == month) expected.push_back(row);
+                }
+                for (const WeatherRecord& record : collection.getDataForMonth(month)) {
+                    found.emplace_back(record.timestamp.GetMinutesSinceEpoch(), record.windSpeed);
+                }
+                std::sort(expected.begin(), expected.end());
+                std::sort(found.begin(), found.end());
+
+                bool inTimeOrder = true;
+                for (int year : {2016, 2017}) {
+                    std::vector<WeatherRecord> records = collection.getDataForYearMonth(year, month);
+                    inTimeOrder = inTimeOrder && std::is_sorted(records.begin(), records.end());
+                }
+                if (found != expected || collection.getViewForMonth(month).size() != expected.size() ||
+                    !inTimeOrder) {
+                    wrongMonths++;
+                    detail << loads[load] << " month " << month << " wrong, ";
+                }
+            }
+        }
+        bool snapshotWritten = std::filesystem::exists(sourceFile.string() + ".snapshot");
+
+        detail << written.size() << " rows, " << wrongMonths << " of 52 checks wrong"
+               << (snapshotWritten ? "" : ", no snapshot written");
+        return report("month-queries", wrongMonths == 0 && snapshotWritten, detail.str());
+    }
+
+    // Correlation of S, RH, DP and T (read through a padded " RH " header
+    // name) over March and over part of it, against a two-pass reference on
+    // the rows written: from the CSV file, from its snapshot, out of core and
+    // from the store reopened. The last row is cut off mid-line, so it is not
+    // stored and must not count. A column that is not stored is refused.
+    bool checkStoredColumns() {
+        ScratchDirectory scratch("stored-columns");
+        std::filesystem::path dataFile = scratch / "MetData.csv";
+        std::filesystem::path sourceFile = scratch / "source.txt";
+        appendText(sourceFile, dataFile.string() + "\n");
+
+        const std::vector<std::string> names = {"S", "RH", "DP", "T"};
+        const DateTime from(Date(10, 3, 2016), 6, 0), to(Date(20, 3, 2016), 18, 30);
+        std::vector<std::vector<double>> monthRows, rangeRows; // values of names, row by row
+        std::string text = "WAST,DP,Dta,Dts,EV,QFE,QFF,QNH,RF, RH ,S,SR,T,ST1,ST2,ST3,ST4,Sx\n";
+        std::uint32_t state = 283;
+        for (int day = 1; day <= 31; day++) {
+            for (int minutes = 0; minutes < 24 * 60; minutes += 30) {
+                state = state * 1664525u + 1013904223u;
+                double windSpeed = state >> 27;
+                double humidity = 20 + (state >> 9) % 800 / 10.0 - windSpeed;
+                double dewPoint = 1e4 + (state >> 3) % 50 / 10.0 + humidity / 8; // badly centred
+                double temperature = (state >> 14) % 4000 / 100.0;
+                std::ostringstream row;
+                row.precision(17); // the values read back are the values written
+                row << (day < 10 ? "0" : "") << day << "/03/2016 " << minutes / 60 << ':' << minutes % 60 / 10 << '0'
+                    << ',' << dewPoint << ",221,34,0,1013.4,1016.9,1017,0," << humidity << ',' << windSpeed << ",512,"
+                    << temperature << ",22.7,24.1,25.5,26.1,8\n";
+                text += row.str();
+
+                DateTime timestamp(Date(day, 3, 2016), minutes / 60, minutes % 60);
+                monthRows.push_back({windSpeed, humidity, dewPoint, temperature});
+                if (!(timestamp < from) && timestamp < to) rangeRows.push_back(monthRows.back());
+            }
+        }
+        appendText(dataFile, text + "31/03/2016 23:59,12.2,221,34,0,1013.4,1016.9,1017,0,99");
+
+        // Two-pass correlation of columns i and j
+        auto reference = [](const std::vector<std::vector<double>>& rows, std::size_t i, std::size_t j) {
+            double meanI = 0, meanJ = 0;
+            for (const std::vector<double>& row : rows) {
+                meanI += row[i] / rows.size();
+                meanJ += row[j] / rows.size();
+            }
+            double sumIJ = 0, sumII = 0, sumJJ = 0;
+            for (const std::vector<double>& row : rows) {
+                sumIJ += (row[i] - meanI) * (row[j] - meanJ);
+                sumII += (row[i] - meanI) * (row[i] - meanI);
+                sumJJ += (row[j] - meanJ) * (row[j] - meanJ);
+            }
+            return sumIJ / std::sqrt(sumII * sumJJ);
+        };
+
+        const char* const loads[] = {"files", "snapshot", "segments", "reopened segments"};
+        int wrong = 0;
+        bool refused = true;
+        std::ostringstream detail;
+        for (int load = 0; load < 4; load++) {
+            QuietOutput quiet;
+            WeatherDataCollection collection;
+            collection.setExtraColumns({"RH", "DP"});
+            if (load >= 2) collection.openSegmentStore((scratch / "segments").string(), 1 << 20);
+            if (load < 3) collection.loadFromFiles(sourceFile.string());
+
+            Statistics::CoMomentMatrix month = collection.getCorrelationMatrix(names, 3);
+            Statistics::CoMomentMatrix range = collection.getCorrelationMatrix(names, from, to);
+            bool matches = month.getCount() == monthRows.size() && range.getCount() == rangeRows.size() &&
+                           std::fabs(month.correlation(0, 3) - collection.calculateSPCC(3, "S_T")) < 1e-12;
+            for (std::size_t i = 0; i < names.size(); i++) {
+                for (std::size_t j = 0; j < names.size(); j++) {
+                    double expected = (i == j) ? 1.0 : reference(monthRows, i, j);
+                    double expectedInRange = (i == j) ? 1.0 : reference(rangeRows, i, j);
+                    matches = matches && std::fabs(month.correlation(i, j) - expected) < 1e-9 &&
+                              std::fabs(range.correlation(i, j) - expectedInRange) < 1e-9;
+                }
+            }
+            if (!matches) {
+                wrong++;
+                detail << loads[load] << " wrong, ";
+            }
+
+            try {
+                collection.getCorrelationMatrix({"S", "QNH"}, 3);
+                refused = false;
+            } catch (const std::invalid_argument&) {
+            }
+        }
+
+        detail << monthRows.size() << " rows, " << rangeRows.size() << " in range, " << wrong << " of 4 loads wrong"
+               << (refused ? ", unstored column refused" : ", unstored column accepted");
+        return report("stored-columns", wrong == 0 && refused, detail.str());
+    }
+
+    // Rows in the store as opened, and after loading the source file into it
+    int countSegmentRows(const std::filesystem::path& storeDirectory, const std::filesystem::path& sourceFile,
+                         int* rowsOnOpen = nullptr) {
+        QuietOutput quiet;
+        WeatherDataCollection collection;
+        collection.openSegmentStore(storeDirectory.string(), 1 << 20);
+        if (rowsOnOpen != nullptr) *rowsOnOpen = collection.getTotalRecords();
+        collection.loadFromFiles(sourceFile.string());
+        return collection.getTotalRecords();
+    }
+
+    std::string readBytes(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    // A month of rows parsed in batches of a few KB, each starting where the
+    // last one ended, against one parse of the whole file: the same records,
+    // and every batch ends at the end of a line
+    bool checkBatchedParse() {
+        ScratchDirectory scratch("parse-batches");
+        std::filesystem::path dataFile = scratch / "MetData.csv";
+        appendText(dataFile, monthOfRows());
+        std::string text = readBytes(dataFile);
+
+        RecordBatch whole;
+        MetDataParser::parseFile(dataFile.string(), whole, 0, true);
+
+        std::vector<WeatherRecord> batched;
+        int batches = 0, cutMidLine = 0;
+        long long rows = 0;
+        for (std::size_t offset = 0;; batches++) {
+            RecordBatch batch;
+            MetDataParser::parseFile(dataFile.string(), batch, offset, true, 4096);
+            if (batch.bytes == 0) break;
+            if (batch.bytes < 4096 && batch.endOffset != text.size()) cutMidLine++;
+            if (text[batch.endOffset - 1] != '\n') cutMidLine++;
+            batched.insert(batched.end(), batch.records.begin(), batch.records.end());
+            rows += batch.rows;
+            offset = batch.endOffset;
+        }
+
+        bool same = batched.size() == whole.records.size() && rows == whole.rows;
+        for (std::size_t i = 0; same && i < batched.size(); i++) {
+            const WeatherRecord& a = batched[i];
+            const WeatherRecord& b = whole.records[i];
+            same = a.timestamp == b.timestamp && a.windSpeed == b.windSpeed && a.temperature == b.temperature &&
+                   a.solarRadiation == b.solarRadiation;
+        }
+
+        std::ostringstream detail;
+        detail << batched.size() << " of " << whole.records.size() << " records in " << batches << " batches"
+               << (same ? "" : ", records differ") << (cutMidLine == 0 ? "" : ", a batch ended mid-line");
+        return report("parse-batches", same && cutMidLine == 0 && batches > 1, detail.str());
+    }
+
+    // Every 2016 answer options 3 and 4 give from the partitions: the monthly
+    // report, each month's correlations and its percentile sketches
+    std::string monthlySummary(const WeatherDataCollection& collection, const std::filesystem::path& reportFile) {
+        collection.generateMonthlyStats(2016, reportFile.string());
+        std::ostringstream summary;
+        summary.precision(17);
+        summary << readBytes(reportFile);
+        for (int month = 1; month <= 12; month++) {
+            Statistics::CoMomentMatrix matrix = collection.getCorrelationMatrix({"S", "T", "SR"}, month);
+            summary << matrix.getCount();
+            for (std::size_t i = 0; i < 3; i++) {
+                summary << ',' << matrix.getMean(i);
+                for (std::size_t j = 0; j < 3; j++) summary << ',' << matrix.getCoMoment(i, j);
+            }
+            for (MeasuredField field : {MeasuredField::WindSpeed, MeasuredField::Temperature,
+                                        MeasuredField::SolarRadiation}) {
+                Statistics::QuantileSketch sketch = collection.getQuantileSketch(field, 2016, month);
+                summary << ',' << sketch.getCount() << ',' << sketch.getRetainedCount();
+                for (double fraction : {0.05, 0.5, 0.95}) summary << ',' << sketch.quantile(fraction);
+            }
+            summary << '\n';
+        }
+        return summary.str();
+    }
+
+    // The partitions a snapshot stores against those of the CSV load that
+    // wrote it, over March rows split into runs by a second file: loaded as
+    // stored, rebuilt from the rows when the stored index is damaged, and
+    // still giving the answers of a CSV load when a refresh adds the same rows
+    // to the partitions read back.
+    bool checkSnapshotPartitions() {
+        ScratchDirectory scratch("snapshot-partitions");
+        std::filesystem::path marchFile = scratch / "MetData_March.csv";
+        std::filesystem::path yearFile = scratch / "MetData_2016.csv";
+        std::filesystem::path sourceFile = scratch / "source.txt";
+        std::filesystem::path snapshotFile = sourceFile.string() + ".snapshot";
+        std::vector<std::pair<std::int64_t, double>> written;
+        appendText(marchFile, monthOfRows());
+        writeYearOfRows(yearFile, 2016, written, 5);
+        appendText(sourceFile, marchFile.string() + "\n" + yearFile.string() + "\n");
+
+        std::string loaded[5];
+        std::string stored, damaged;
+        bool damagedKept = false;
+        for (int load = 0; load < 5; load++) {
+            QuietOutput quiet;
+            WeatherDataCollection collection;
+            collection.setSnapshotEnabled(load < 4);
+            if (load == 4) std::ofstream(marchFile, std::ios::binary | std::ios::trunc) << monthOfRows();
+            collection.loadFromFiles(sourceFile.string());
+            if (load >= 3) {
+                // Rows between those already in March, as if the file were still being written
+                std::string rows;
+                for (int day = 1; day <= 31; day++) {
+                    for (int hour = 1; hour < 24; hour++) {
+                        if (hour % 6 != 0) rows += dataRow(day, hour, 5, hour, 100 + day, 15.5) + "\n";
+                    }
+                }
+                appendText(marchFile, rows);
+                collection.refreshFromFiles();
+            }
+            loaded[load] = monthlySummary(collection, scratch / "report.csv");
+
+            if (load == 0) {
+                // Count one partition more than the index holds
+                stored = readBytes(snapshotFile);
+                std::uint64_t indexBytes = 0, partitionCount = 0;
+                std::memcpy(&indexBytes, stored.data() + 40, sizeof(indexBytes));
+                std::size_t indexStart = stored.size() - ((indexBytes + 7) & ~std::uint64_t(7));
+                std::memcpy(&partitionCount, stored.data() + indexStart, sizeof(partitionCount));
+                partitionCount++;
+                damaged = stored;
+                std::memcpy(&damaged[indexStart], &partitionCount, sizeof(partitionCount));
+                std::ofstream(snapshotFile, std::ios::binary | std::ios::trunc) << damaged;
+            } else if (load == 2) {
+                damagedKept = readBytes(snapshotFile) == damaged;
+                std::ofstream(snapshotFile, std::ios::binary | std::ios::trunc) << stored;
+            }
+        }
+
+        // A damaged index must not stop the snapshot being used; a snapshot that was not
+        // used would have been written again
+        std::ostringstream detail;
+        bool asStored = loaded[1] == loaded[0] && !stored.empty();
+        bool rebuilt = loaded[2] == loaded[0] && damagedKept;
+        bool refreshed = loaded[3] == loaded[4] && loaded[3] != loaded[0];
+        detail << (asStored ? "snapshot matches CSV load" : "snapshot differs from CSV load")
+               << (rebuilt ? ", damaged index rebuilt" : ", damaged index not rebuilt from the snapshot rows")
+               << (refreshed ? ", refresh matches CSV load" : ", refresh differs from CSV load");
+        return report("snapshot-partitions", asStored && rebuilt && refreshed, detail.str());
+    }
+
+    // Recreate what a crash in the middle of SegmentStore::append leaves on
+    // disk: the store before the load, with the load's block written past the
+    // end its segment header commits, with or without the journal that
+    // commits it. The load must have appended the block without touching the
+    // rows already stored. Opening the store must finish a committed load and
+    // cut off an uncommitted one; loading the same file again must then give
+    // every row exactly once.
+    bool checkInterruptedAppend(const std::string& name, bool committed) {
+        ScratchDirectory scratch(name);
+        std::filesystem::path dataFile = scratch / "MetData.csv";
+        std::filesystem::path sourceFile = scratch / "source.txt";
+        std::filesystem::path before = scratch / "before";
+        std::filesystem::path after = scratch / "after";
+        std::filesystem::path crashed = scratch / "crashed";
+        const std::string segmentName = "2016-03.seg";
+        const std::size_t headerBytes = 32; // SegmentHeader in SegmentStore.cpp
+
+        appendText(sourceFile, dataFile.string() + "\n");
+        appendText(dataFile, std::string(HEADER) + "\n" + dataRow(28, 16, 50) + "\n" + dataRow(29, 17, 0) + "\n");
+        countSegmentRows(before, sourceFile);
+
+        appendText(dataFile, dataRow(30, 17, 10) + "\n" + dataRow(31, 17, 20) + "\n");
+        std::filesystem::copy(before, after);
+        countSegmentRows(after, sourceFile);
+
+        std::string oldSegment = readBytes(before / segmentName);
+        std::string newSegment = readBytes(after / segmentName);
+        bool tailAppended = oldSegment.size() > headerBytes && newSegment.size() > oldSegment.size() &&
+                            newSegment.compare(headerBytes, oldSegment.size() - headerBytes, oldSegment,
+                                               headerBytes, std::string::npos) == 0;
+
+        // The new block behind the old header, as left before the commit
+        std::filesystem::copy(before, crashed);
+        std::filesystem::remove(crashed / segmentName);
+        appendText(crashed / segmentName, oldSegment.substr(0, headerBytes) + newSegment.substr(headerBytes));
+        if (committed && newSegment.size() >= headerBytes) {
+            std::uint32_t blocks = 0;
+            std::uint64_t rows = 0;
+            std::memcpy(&blocks, newSegment.data() + 12, sizeof(blocks));
+            std::memcpy(&rows, newSegment.data() + 16, sizeof(rows));
+            appendText(crashed / "pending.txt",
+                       "append\t" + std::to_string(oldSegment.size()) + '\t' + std::to_string(newSegment.size()) +
+                       '\t' + std::to_string(rows) + '\t' + std::to_string(blocks) + '\t' + segmentName + "\n" +
+                       "ingested\t" + std::to_string(std::filesystem::file_size(dataFile)) + '\t' +
+                       dataFile.string() + "\n");
+        }
+
+        int rowsOnOpen = -1;
+        int rows = countSegmentRows(crashed, sourceFile, &rowsOnOpen);
+        int stagedLeft = 0;
+        for (const std::filesystem::directory_entry& item : std::filesystem::directory_iterator(crashed)) {
+            std::string fileName = item.path().filename().string();
+            if (fileName == "pending.txt" || item.path().extension() == ".tmp") stagedLeft++;
+        }
+        bool sameSegment = readBytes(crashed / segmentName) == newSegment;
+
+        std::ostringstream detail;
+        int expectedOnOpen = committed ? 4 : 2;
+        detail << rowsOnOpen << " of " << expectedOnOpen << " rows on open, " << rows << " of 4 after reloading, "
+               << stagedLeft << " staged files left" << (tailAppended ? "" : ", stored rows were rewritten")
+               << (sameSegment ? "" : ", segment differs from an uninterrupted load");
+        bool passed = rowsOnOpen == expectedOnOpen && rows == 4 && stagedLeft == 0 && tailAppended && sameSegment;
+        return report(name, passed, detail.str());
+    }
+
+    // count even keys, ascending (order 0), descending (1) or scattered with repeats (2)
+    std::vector<int> treeKeys(int order, int count) {
+        std::vector<int> keys;
+        std::uint32_t state = 2024;
+        for (int i = 0; i < count; i++) {
+            state = state * 1664525u + 1013904223u;
+            int key = (order == 0) ? i : (order == 1) ? count - 1 - i : static_cast<int>((state >> 8) % count);
+            keys.push_back(2 * key);
+        }
+        return keys;
+    }
+
+    template <class T>
+    void collectValue(const T& value, void* context) {
+        static_cast<std::vector<T>*>(context)->push_back(value);
+    }
+
+    template <class T>
+    std::vector<T> inOrderValues(const Bst<T>& tree) {
+        std::vector<T> values;
+        tree.inOrder(collectValue<T>, &values);
+        return values;
+    }
+
+    // A tree of keys against a std::set of the same keys: same values in
+    // order, each one found, the odd values between them not found, and no
+    // higher than an AVL tree may be
+    bool checkBalancedTree(const std::string& name, const std::vector<int>& keys) {
+        Bst<int> tree;
+        std::set<int> reference;
+        for (int key : keys) {
+            tree.insert(key);
+            reference.insert(key);
+        }
+
+        bool ordered = inOrderValues(tree) == std::vector<int>(reference.begin(), reference.end());
+
+        int misses = 0;
+        for (int key : reference) {
+            if (tree.search(key) == nullptr || tree.search(key + 1) != nullptr) misses++;
+        }
+
+        // An AVL tree of n nodes is less than 1.4405 log2(n + 2) high
+        double bound = 1.4405 * std::log2(reference.size() + 2.0);
+        std::ostringstream detail;
+        detail << reference.size() << " values, height " << tree.height() << " of at most " << bound
+               << (ordered ? ", in order" : ", out of order") << ", " << misses << " lookups wrong"
+               << (tree.checkInvariant() ? "" : ", invariant broken");
+        bool passed = ordered && misses == 0 && tree.height() < bound && tree.checkInvariant() &&
+                      tree.size() == static_cast<int>(reference.size());
+        return report(name, passed, detail.str());
+    }
+
+    // Copies and moves of a tree, and values built in place, against the
+    // values that went in
+    bool checkTreeOwnership() {
+        std::vector<int> keys = treeKeys(2, 5000);
+        Bst<int> original;
+        for (int key : keys) original.insert(key);
+        std::vector<int> expected = inOrderValues(original);
+
+        Bst<int> copy(original);
+        bool oneBlock = copy.allocationCount() == 1;
+        copy.insert(-1);
+        bool copied = oneBlock && inOrderValues(original) == expected && copy.size() == original.size() + 1 &&
+                      copy.checkInvariant();
+
+        Bst<int> moved(std::move(copy));
+        Bst<int> assigned;
+        assigned.insert(7);
+        assigned = original;
+        Bst<int> moveAssigned;
+        moveAssigned = std::move(assigned);
+        bool transferred = copy.isEmpty() && copy.allocationCount() == 0 && moved.size() == original.size() + 1 &&
+                           assigned.isEmpty() && inOrderValues(moveAssigned) == expected &&
+                           moveAssigned.checkInvariant();
+
+        Bst<std::string> words;
+        words.emplace(3, 'b');
+        words.emplace("a");
+        std::string longWord(100, 'c');
+        words.insert(std::move(longWord));
+        bool built = inOrderValues(words) == std::vector<std::string>{"a", "bbb", std::string(100, 'c')};
+
+        moved.clear();
+        bool cleared = moved.isEmpty() && moved.allocationCount() == 0;
+
+        std::ostringstream detail;
+        detail << (copied ? "copy independent" : "copy wrong")
+               << (transferred ? ", moves empty the source" : ", move wrong")
+               << (built ? ", emplaced values in order" : ", emplace wrong")
+               << (cleared ? ", clear frees blocks" : ", clear wrong");
+        return report("bst-copy-move", copied && transferred && built && cleared, detail.str());
+    }
+
+    // Iterators and visitors against std::set, and the three traversal
+    // orders of 1..7, which balance into a known perfect tree
+    bool checkTreeTraversals() {
+        Bst<int> tree;
+        std::set<int> reference;
+        for (int key : treeKeys(2, 5000)) {
+            tree.insert(key);
+            reference.insert(key);
+        }
+
+        std::vector<int> iterated(tree.begin(), tree.end());
+        std::vector<int> visited;
+        bool completed = tree.inOrder([&visited](int value) { visited.push_back(value); });
+        bool inOrderMatches = iterated == std::vector<int>(reference.begin(), reference.end()) &&
+                              visited == iterated && completed &&
+                              std::find(tree.begin(), tree.end(), *reference.rbegin()) != tree.end();
+
+        // A visitor returning false stops the walk after that value
+        int seen = 0;
+        bool stopped = !tree.inOrder([&seen](int) { return ++seen < 10; }) && seen == 10;
+
+        Bst<int> small;
+        for (int key = 1; key <= 7; key++) small.insert(key);
+        std::vector<int> pre, post;
+        small.preOrder([&pre](int value) { pre.push_back(value); });
+        small.postOrder([&post](int value) { post.push_back(value); });
+        bool shapeMatches =
+            pre == std::vector<int>{4, 2, 1, 3, 6, 5, 7} && post == std::vector<int>{1, 3, 2, 5, 7, 6, 4};
+
+        std::ostringstream detail;
+        detail << iterated.size() << " of " << reference.size() << " values iterated"
+               << (inOrderMatches ? " in order" : " wrongly")
+               << (stopped ? ", early exit after 10" : ", early exit wrong")
+               << (shapeMatches ? ", pre/post order of 1..7 right" : ", pre/post order of 1..7 wrong");
+        return report("bst-traversal", inOrderMatches && stopped && shapeMatches, detail.str());
+    }
+
+    // rank, select and countInRange against positions in the sorted values,
+    // on the tree and on a copy of it
+    bool checkOrderStatistics() {
+        Bst<int> tree;
+        std::set<int> unique;
+        for (int key : treeKeys(2, 5000)) {
+            tree.insert(key);
+            unique.insert(key);
+        }
+        std::vector<int> sorted(unique.begin(), unique.end());
+        Bst<int> copy(tree);
+
+        int wrong = 0;
+        const int n = static_cast<int>(sorted.size());
+        for (const Bst<int>* subject : {&tree, &copy}) {
+            if (subject->size() != n || subject->select(-1) != nullptr || subject->select(n) != nullptr) wrong++;
+            for (int k = 0; k < n; k++) {
+                const Node<int>* node = subject->select(k);
+                if (node == nullptr || node->data != sorted[k]) wrong++;
+            }
+            // Every present and absent value from below the smallest to above the largest
+            for (int value = -1; value <= sorted.back() + 1; value++) {
+                int below = static_cast<int>(std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin());
+                if (subject->rank(value) != below) wrong++;
+
+                int high = value + 37;
+                int belowHigh =
+                    static_cast<int>(std::lower_bound(sorted.begin(), sorted.end(), high) - sorted.begin());
+                if (subject->countInRange(value, high) != belowHigh - below) wrong++;
+            }
+        }
+
+        std::ostringstream detail;
+        detail << n << " values, " << wrong << " wrong answers" << (tree.checkInvariant() ? "" : ", counts broken");
+        return report("bst-order-statistics", wrong == 0 && tree.checkInvariant(), detail.str());
+    }
+
+    // search, lowerBound, upperBound and visitRange against std::set for
+    // every value in and around the stored range
+    bool checkTreeBounds() {
+        Bst<int> tree;
+        std::set<int> reference;
+        for (int key : treeKeys(2, 5000)) {
+            tree.insert(key);
+            reference.insert(key);
+        }
+
+        int wrong = 0;
+        for (int value = -1; value <= *reference.rbegin() + 1; value++) {
+            std::set<int>::const_iterator lower = reference.lower_bound(value);
+            std::set<int>::const_iterator upper = reference.upper_bound(value);
+            Bst<int>::const_iterator treeLower = tree.lowerBound(value);
+            Bst<int>::const_iterator treeUpper = tree.upperBound(value);
+
+            if ((lower == reference.end()) != (treeLower == tree.end()) ||
+                (lower != reference.end() && *lower != *treeLower)) wrong++;
+            if ((upper == reference.end()) != (treeUpper == tree.end()) ||
+                (upper != reference.end() && *upper != *treeUpper)) wrong++;
+            if ((tree.search(value) != nullptr) != (reference.count(value) == 1)) wrong++;
+        }
+
+        // Ranges with ends on and between stored values, empty and reversed
+        const int ranges[][2] = {{-5, 40},   {100, 101}, {101, 103},    {2000, 4000},
+                                 {500, 500}, {600, 200}, {9000, 20000}};
+        for (const int* range : ranges) {
+            std::vector<int> visited;
+            tree.visitRange(range[0], range[1], [&visited](int value) { visited.push_back(value); });
+            std::vector<int> expected;
+            for (int value : reference) {
+                if (range[0] <= value && value < range[1]) expected.push_back(value);
+            }
+            if (visited != expected) wrong++;
+        }
+
+        // Lookups by a key of another type that orders against the values
+        Bst<std::string> words;
+        for (const char* word : {"wind", "solar", "temperature"}) words.emplace(word);
+        bool otherKey = words.search("solar") != nullptr && words.search("rain") == nullptr &&
+                        *words.lowerBound("sun") == "temperature";
+
+        std::ostringstream detail;
+        detail << reference.size() << " values, " << wrong << " wrong answers"
+               << (otherKey ? ", string keys by const char*" : ", lookup by const char* wrong");
+        return report("bst-bounds", wrong == 0 && otherKey, detail.str());
+    }
+
+    // Batches bulk-loaded one after another with insertSorted, against the
+    // same values in a std::set: into an empty tree, merged into a large
+    // tree, a batch small enough to insert one at a time, and unsorted input
+    bool checkBulkLoad() {
+        Bst<int> tree;
+        std::set<int> reference;
+        std::vector<std::vector<int>> batches;
+
+        std::vector<int> first;
+        for (int key = 0; key < 4095; key++) first.push_back(2 * key);
+        batches.push_back(first);
+
+        std::vector<int> merged;
+        for (int key = 1; key < 12000; key += 3) merged.push_back(key); // odd and even, some present
+        batches.push_back(merged);
+        batches.push_back({-6, 5, 7, 9});
+        batches.push_back({50001, 40003, 60005, 40003});
+
+        int wrong = 0;
+        int emptyTreeHeight = -1;
+        for (const std::vector<int>& batch : batches) {
+            tree.insertSorted(batch.begin(), batch.end());
+            reference.insert(batch.begin(), batch.end());
+            if (emptyTreeHeight < 0) emptyTreeHeight = tree.height();
+            bool matches = inOrderValues(tree) == std::vector<int>(reference.begin(), reference.end()) &&
+                           tree.size() == static_cast<int>(reference.size());
+            if (!matches || !tree.checkInvariant()) wrong++;
+        }
+
+        // 4095 values fill a perfect tree of height 11
+        std::ostringstream detail;
+        detail << batches.size() << " batches, " << reference.size() << " values, " << wrong
+               << " wrong after a batch, first batch height " << emptyTreeHeight << " of 11";
+        return report("bst-bulk-load", wrong == 0 && emptyTreeHeight == 11, detail.str());
+    }
+
+    int daysInMonth(int month, int year) {
+        const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        return (month == 2 && leap) ? 29 : days[month - 1];
+    }
+
+    // Every day from 1/1/1900 to 31/12/2100, counted one at a time: its
+    // packed minutes, the date unpacked again, and the order against the
+    // day before. Times of day within a day, and parsing a MetData timestamp.
+    bool checkDateTimePacking() {
+        // Days from 1/1/1900 to 1/1/1970
+        std::int64_t epochDay = 0;
+        for (int year = 1900; year < 1970; year++) epochDay += (daysInMonth(2, year) == 29) ? 366 : 365;
+
+        int wrong = 0, days = 0;
+        std::int64_t dayNumber = 0;
+        DateTime previous;
+        for (int year = 1900; year <= 2100; year++) {
+            for (int month = 1; month <= 12; month++) {
+                for (int day = 1; day <= daysInMonth(month, year); day++, dayNumber++, days++) {
+                    DateTime midnight(Date(day, month, year));
+                    Date unpacked = midnight.GetDate();
+                    bool matches = midnight.GetMinutesSinceEpoch() == (dayNumber - epochDay) * 1440 &&
+                                   unpacked.GetDay() == day && unpacked.GetMonth() == month &&
+                                   unpacked.GetYear() == year && midnight.GetHour() == 0 && midnight.GetMinute() == 0;
+                    if (!matches || (days > 0 && !(previous < midnight))) wrong++;
+                    previous = midnight;
+                }
+            }
+        }
+
+        DateTime morning(Date(31, 12, 1969), 9, 5);
+        DateTime evening(Date(31, 12, 1969), 23, 59);
+        bool timesMatch = morning.GetHour() == 9 && morning.GetMinute() == 5 && morning.GetDay() == 31 &&
+                          evening.GetYear() == 1969 && morning < evening &&
+                          evening < DateTime(Date(1, 1, 1970)) &&
+                          DateTime::fromMinutes(evening.GetMinutesSinceEpoch()) == evening;
+        bool parsed = MetDataParser::parseDateTime("31/03/2016 9:05") == DateTime(Date(31, 3, 2016), 9, 5);
+
+        std::ostringstream detail;
+        detail << days << " days, " << wrong << " wrong"
+               << (timesMatch ? ", times of day right" : ", times of day wrong")
+               << (parsed ? ", parsed timestamp right" : ", parsed timestamp wrong");
+        return report("datetime-packing", wrong == 0 && timesMatch && parsed, detail.str());
+    }
+
+    // The same days as day numbers: each one against the count, formatted
+    // as d/m/yyyy and parsed back, and the calendar rules against the table
+    // above. Invalid dates must be refused by both isValid and parse.
+    bool checkDateNumbers() {
+        std::int64_t epochDay = 0;
+        for (int year = 1900; year < 1970; year++) epochDay += (daysInMonth(2, year) == 29) ? 366 : 365;
+
+        int wrong = 0, days = 0;
+        std::int64_t dayNumber = 0;
+        char buffer[Date::MAX_FORMAT_LENGTH];
+        for (int year = 1900; year <= 2100; year++) {
+            for (int month = 1; month <= 12; month++) {
+                if (Date::daysInMonth(month, year) != daysInMonth(month, year)) wrong++;
+                for (int day = 1; day <= daysInMonth(month, year); day++, dayNumber++, days++) {
+                    Date date(day, month, year);
+                    std::string expected = std::to_string(day) + "/" + std::to_string(month) + "/" +
+                                           std::to_string(year);
+                    char* end = date.format(buffer, buffer + sizeof(buffer));
+                    Date parsed;
+                    bool matches = date.GetDaysSinceEpoch() == dayNumber - epochDay &&
+                                   Date::fromDays(date.GetDaysSinceEpoch()) == date &&
+                                   end != nullptr && std::string(buffer, end) == expected &&
+                                   Date::parse(buffer, end, parsed) == end && parsed == date &&
+                                   Date::isValid(day, month, year);
+                    if (!matches) wrong++;
+                }
+            }
+        }
+
+        const char* invalid[] = {"29/2/1900", "31/4/2016", "0/1/2016", "1/13/2016", "32/1/2016", "1/1"};
+        int accepted = 0;
+        for (const char* text : invalid) {
+            Date parsed;
+            if (Date::parse(text, text + std::strlen(text), parsed) != nullptr) accepted++;
+        }
+        bool rules = Date::isLeapYear(2000) && !Date::isLeapYear(1900) && Date::isLeapYear(2016) &&
+                     !Date::isValid(29, 2, 2015) && Date::isValid(29, 2, 2016);
+        char small[4];
+        bool fits = Date(1, 1, 2016).format(small, small + sizeof(small)) == nullptr;
+
+        std::ostringstream detail;
+        detail << days << " days, " << wrong << " wrong, " << accepted << " invalid dates parsed"
+               << (rules ? ", calendar rules right" : ", calendar rules wrong")
+               << (fits ? "" : ", wrote past a short buffer");
+        return report("date-numbers", wrong == 0 && accepted == 0 && rules && fits, detail.str());
+    }
+
+    // One backend against std::map: the same findOrInsert/insert sequence,
+    // then lookups of every key and of keys never inserted, at() on a
+    // missing key, a walk of the entries (in key order if ordered), and
+    // values updated through iterators.
+    template <class MapType>
+    bool checkMapBackend(const std::string& name, const std::vector<int>& keys, const std::vector<int>& misses,
+                         bool ordered) {
+        MapType map;
+        std::map<int, int> reference;
+        for (std::size_t i = 0; i < keys.size(); i++) {
+            if (i % 3 == 0) {
+                map.insert(keys[i], static_cast<int>(i));
+                reference[keys[i]] = static_cast<int>(i);
+            } else {
+                map.findOrInsert(keys[i]) += keys[i];
+                reference[keys[i]] += keys[i];
+            }
+        }
+
+        int wrong = 0;
+        for (const std::pair<const int, int>& entry : reference) {
+            const int* value = map.find(entry.first);
+            if (value == nullptr || *value != entry.second || !map.contains(entry.first) ||
+                map.at(entry.first) != entry.second) wrong++;
+        }
+        for (int key : misses) {
+            if (reference.count(key) == 0 && (map.find(key) != nullptr || map.contains(key))) wrong++;
+        }
+
+        const MapType& constMap = map;
+        bool threw = false;
+        try {
+            constMap.at(misses.front());
+        } catch (const std::out_of_range&) {
+            threw = true;
+        }
+
+        std::vector<std::pair<int, int>> walked;
+        for (typename MapType::const_iterator it = constMap.begin(); it != constMap.end(); ++it) {
+            walked.emplace_back(it->first, it->second);
+        }
+        if (!ordered) std::sort(walked.begin(), walked.end());
+        bool walkMatches = walked == std::vector<std::pair<int, int>>(reference.begin(), reference.end());
+
+        // Values can be changed through iterators, keys cannot
+        static_assert(std::is_const<typename std::remove_reference<decltype((*map.begin()).first)>::type>::value,
+                      "Map iterators must not expose a mutable key");
+        for (typename MapType::iterator it = map.begin(); it != map.end(); ++it) {
+            it->second += 1;
+        }
+        for (auto&& entry : map) {
+            entry.second *= 2;
+        }
+        int wrongUpdates = 0;
+        for (const std::pair<const int, int>& entry : reference) {
+            if (map.at(entry.first) != (entry.second + 1) * 2) wrongUpdates++;
+        }
+
+        std::ostringstream detail;
+        detail << reference.size() << " keys, " << wrong << " wrong lookups"
+               << (walkMatches ? ", iteration matches" : ", iteration differs")
+               << (threw ? "" : ", at() on a missing key did not throw")
+               << ", " << wrongUpdates << " values wrong after updates through iterators";
+        return report(name, wrong == 0 && threw && walkMatches && wrongUpdates == 0 && map.size() == reference.size(),
+                      detail.str());
+    }
+
+    // |a - b| within the reordered-summation bound 2 n eps sum|t| of StatKernels.h
+    bool withinSumBound(double a, long double b, std::size_t n, long double sumAbs) {
+        return std::fabs(static_cast<long double>(a) - b) <= 2.0L * (n + 1) * DBL_EPSILON * sumAbs + 1e-300L;
+    }
+
+    // Every kernel at every level this CPU supports, against a plain loop in
+    // long double, on lengths that leave every possible tail after the vector
+    // part. Each level must also agree with the scalar kernel to that bound.
+    bool checkKernelDispatch() {
+        const std::size_t lengths[] = {0, 1, 2, 3, 5, 7, 8, 15, 16, 17, 31, 33, 1000, 4099};
+        std::vector<double> x(4099), y(4099);
+        unsigned seed = 283;
+        for (std::size_t i = 0; i < x.size(); i++) {
+            seed = seed * 1103515245u + 12345u;
+            x[i] = static_cast<double>(seed >> 8) / (1 << 16) - 100.0;
+            seed = seed * 1103515245u + 12345u;
+            y[i] = 0.5 * x[i] + static_cast<double>(seed >> 8) / (1 << 20);
+        }
+
+        StatKernels::IsaLevel original = StatKernels::getIsaLevel();
+        StatKernels::IsaLevel best = StatKernels::detectIsaLevel();
+        std::ostringstream detail;
+        int levels = 0, wrong = 0;
+        bool clamped = true;
+        for (int level = 0; level <= static_cast<int>(StatKernels::IsaLevel::AVX512); level++) {
+            StatKernels::setIsaLevel(static_cast<StatKernels::IsaLevel>(level));
+            if (level > static_cast<int>(best)) {
+                clamped = clamped && StatKernels::getIsaLevel() == best;
+                continue;
+            }
+            if (StatKernels::getIsaLevel() != static_cast<StatKernels::IsaLevel>(level)) {
+                clamped = false;
+                continue;
+            }
+            levels++;
+            detail << (levels > 1 ? ", " : "") << StatKernels::isaName(StatKernels::getIsaLevel());
+
+            for (std::size_t n : lengths) {
+                long double sum = 0, sumAbs = 0, sumY = 0;
+                for (std::size_t i = 0; i < n; i++) {
+                    sum += x[i];
+                    sumAbs += std::fabs(x[i]);
+                    sumY += y[i];
+                }
+                double mean = (n > 0) ? static_cast<double>(sum / n) : 0.0;
+                double meanY = (n > 0) ? static_cast<double>(sumY / n) : 0.0;
+                long double squares = 0, absolute = 0, squaresY = 0, cross = 0, absCross = 0;
+                for (std::size_t i = 0; i < n; i++) {
+                    long double deviation = x[i] - mean;
+                    long double deviationY = y[i] - meanY;
+                    squares += deviation * deviation;
+                    absolute += std::fabs(deviation);
+                    squaresY += deviationY * deviationY;
+                    cross += deviation * deviationY;
+                    absCross += std::fabs(deviation * deviationY);
+                }
+
+                StatKernels::CenteredSums centered =
+                    StatKernels::centeredPairSums(x.data(), y.data(), n, mean, meanY);
+                double squaresFound = StatKernels::sumSquaredDeviations(x.data(), n, mean);
+                double absoluteFound = StatKernels::sumAbsDeviations(x.data(), n, mean);
+                bool matches = withinSumBound(StatKernels::sum(x.data(), n), sum, n, sumAbs) &&
+                               withinSumBound(squaresFound, squares, n, squares) &&
+                               withinSumBound(absoluteFound, absolute, n, absolute) &&
+                               withinSumBound(centered.sumDX2, squares, n, squares) &&
+                               withinSumBound(centered.sumDY2, squaresY, n, squaresY) &&
+                               withinSumBound(centered.sumDXDY, cross, n, absCross);
+                if (!matches) wrong++;
+            }
+        }
+        StatKernels::setIsaLevel(original);
+
+        detail << ": " << wrong << " of " << levels * (sizeof(lengths) / sizeof(lengths[0]))
+               << " length checks outside the rounding bound"
+               << (clamped ? "" : ", unsupported level not clamped");
+        return report("kernel-dispatch", levels > 0 && wrong == 0 && clamped, detail.str());
+    }
+
+    // Relative difference of a from the reference b, against the scale of b
+    bool closeTo(double a, long double b, long double tolerance) {
+        return std::fabs(static_cast<long double>(a) - b) <= tolerance * std::max(1.0L, std::fabs(b));
+    }
+
+    bool matchesTwoPass(const Statistics::CoMoments& found, const std::vector<double>& x,
+                        const std::vector<double>& y, std::size_t first, std::size_t last) {
+        long double meanX = 0, meanY = 0;
+        for (std::size_t i = first; i < last; i++) {
+            meanX += x[i];
+            meanY += y[i];
+        }
+        std::size_t n = last - first;
+        meanX /= n;
+        meanY /= n;
+        long double m2X = 0, m2Y = 0, cXY = 0;
+        for (std::size_t i = first; i < last; i++) {
+            m2X += (x[i] - meanX) * (x[i] - meanX);
+            m2Y += (y[i] - meanY) * (y[i] - meanY);
+            cXY += (x[i] - meanX) * (y[i] - meanY);
+        }
+        long double correlation = cXY / std::sqrt(m2X * m2Y);
+        return found.count == n && closeTo(found.meanX, meanX, 1e-13L) && closeTo(found.meanY, meanY, 1e-13L) &&
+               closeTo(found.m2X, m2X, 1e-9L) && closeTo(found.m2Y, m2Y, 1e-9L) && closeTo(found.cXY, cXY, 1e-9L) &&
+               closeTo(found.correlation(), correlation, 1e-9L);
+    }
+
+    // CoMoments on pairs with means near 1e6, where the textbook sum formula
+    // loses most of its digits: pair by pair, in blocks, and as partial
+    // results merged (Chan et al.) in uneven pieces and in either order, each
+    // against a long double two-pass reference.
+    bool checkCoMomentMerge() {
+        std::vector<double> x(20000), y(20000);
+        unsigned seed = 21;
+        for (std::size_t i = 0; i < x.size(); i++) {
+            seed = seed * 1103515245u + 12345u;
+            double noise = static_cast<double>(seed >> 8) / (1 << 24) - 0.5;
+            seed = seed * 1103515245u + 12345u;
+            x[i] = 1e6 + static_cast<double>(seed >> 8) / (1 << 24);
+            y[i] = 2e6 - 0.6 * x[i] + noise;
+        }
+
+        Statistics::CoMoments pairwise;
+        for (std::size_t i = 0; i < x.size(); i++) pairwise.add(x[i], y[i]);
+        Statistics::CoMoments blocked;
+        blocked.add(x.data(), y.data(), x.size());
+
+        // Pieces of 0, 1, 7, 513 and the rest, merged forwards and backwards
+        const std::size_t cuts[] = {0, 0, 1, 8, 521, x.size()};
+        std::vector<Statistics::CoMoments> pieces;
+        bool piecesMatch = true;
+        for (std::size_t i = 0; i + 1 < sizeof(cuts) / sizeof(cuts[0]); i++) {
+            Statistics::CoMoments piece;
+            piece.add(x.data() + cuts[i], y.data() + cuts[i], cuts[i + 1] - cuts[i]);
+            if (cuts[i + 1] - cuts[i] >= 2) {
+                piecesMatch = matchesTwoPass(piece, x, y, cuts[i], cuts[i + 1]) && piecesMatch;
+            }
+            pieces.push_back(piece);
+        }
+        Statistics::CoMoments forwards, backwards;
+        for (std::size_t i = 0; i < pieces.size(); i++) {
+            forwards.merge(pieces[i]);
+            backwards.merge(pieces[pieces.size() - 1 - i]);
+        }
+
+        Statistics::CoMoments single, constant;
+        single.add(1.0, 2.0);
+        for (int i = 0; i < 10; i++) constant.add(5.0, i);
+        bool degenerate = single.correlation() == 0.0 && constant.correlation() == 0.0;
+
+        bool allMatch = matchesTwoPass(pairwise, x, y, 0, x.size()) && matchesTwoPass(blocked, x, y, 0, x.size()) &&
+                        matchesTwoPass(forwards, x, y, 0, x.size()) && matchesTwoPass(backwards, x, y, 0, x.size());
+        std::ostringstream detail;
+        detail << x.size() << " pairs, correlation " << blocked.correlation()
+               << (allMatch ? ", whole and merged match two-pass" : ", differs from two-pass")
+               << (piecesMatch ? "" : ", a piece differs")
+               << (degenerate ? "" : ", degenerate input not 0");
+        return report("comoments-merge", allMatch && piecesMatch && degenerate, detail.str());
+    }
+
+    bool checkMapBackends() {
+        std::vector<int> keys, misses;
+        unsigned seed = 2016;
+        for (int i = 0; i < 5000; i++) {
+            seed = seed * 1103515245u + 12345u;
+            keys.push_back(static_cast<int>((seed >> 8) % 4000) - 2000); // repeats and negative keys
+            misses.push_back(static_cast<int>(seed >> 8) % 4000 + 2000);
+        }
+        misses.push_back(-2001);
+
+        bool passed = checkMapBackend<Map<int, int>>("map-tree", keys, misses, true);
+        passed = checkMapBackend<Map<int, int, FlatBackend<int, int>>>("map-flat", keys, misses, true) && passed;
+        passed = checkMapBackend<Map<int, int, HashBackend<int, int>>>("map-hash", keys, misses, false) && passed;
+
+        std::vector<int> months, monthMisses = {0, 13, -1, 100};
+        for (int key : keys) months.push_back((key & 0xff) % 12 + 1);
+        passed = checkMapBackend<MonthMap<int>>("map-dense", months, monthMisses, true) && passed;
+
+        MonthMap<int> dense;
+        bool rangeChecked = false;
+        try {
+            dense.findOrInsert(13);
+        } catch (const std::out_of_range&) {
+            rangeChecked = dense.empty();
+        }
+        return report("map-dense-range", rangeChecked,
+                      rangeChecked ? "key 13 refused" : "key 13 accepted") && passed;
+    }
+}
+
+namespace SelfTest
+{
+    bool runHeaderTest()
+    {
+        std::ostringstream detail;
+        int layouts = 0, passed = 0;
+        for (const HeaderCase& test : HEADER_CASES) {
+            layouts++;
+            if (checkHeaderCase(test, detail)) passed++;
+        }
+
+        // A header without SR, and a row that stops before the last column needed
+        MetDataParser parser;
+        bool missingFound = !parser.readHeader("WAST,S,T") && parser.getMissingColumn() == "SR";
+        WeatherRecord record(DateTime(), 0.0, 0.0, 0.0);
+        bool shortRowFound = parser.readHeader(HEADER_CASES[0].header) &&
+                             !parser.parseRecord("31/03/2016 9:00,12.2,221,34,0,1013.4", record);
+
+        detail << passed << " of " << layouts << " layouts read back"
+               << (missingFound ? ", missing SR reported" : ", missing SR not reported")
+               << (shortRowFound ? ", short row rejected" : ", short row accepted");
+        return report("header-projection", passed == layouts && missingFound && shortRowFound, detail.str());
+    }
+
+    bool runFollowModeTest()
+    {
+        bool inMemory = checkFollowMode("follow-mode-in-memory", false);
+        bool outOfCore = checkFollowMode("follow-mode-segments", true);
+        bool batched = checkBatchedParse();
+        return inMemory && outOfCore && batched;
+    }
+
+    bool runPercentileTest()
+    {
+        bool inMemory = checkPercentiles("percentiles-in-memory", false);
+        bool outOfCore = checkPercentiles("percentiles-segments", true);
+        return inMemory && outOfCore;
+    }
+
+    bool runMonthQueryTest()
+    {
+        bool months = checkMonthQueries();
+        bool snapshot = checkSnapshotPartitions();
+        return months && snapshot;
+    }
+
+    bool runCorrelationTest()
+    {
+        return checkStoredColumns();
+    }
+
+    bool runInterruptedAppendTest()
+    {
+        bool committed = checkInterruptedAppend("interrupted-append-committed", true);
+        bool uncommitted = checkInterruptedAppend("interrupted-append-uncommitted", false);
+        return committed && uncommitted;
+    }
+
+    bool runBstTest()
+    {
+        bool passed = checkBalancedTree("bst-ascending", treeKeys(0, 10000));
+        passed = checkBalancedTree("bst-descending", treeKeys(1, 10000)) && passed;
+        passed = checkBalancedTree("bst-scattered", treeKeys(2, 10000)) && passed;
+        passed = checkTreeOwnership() && passed;
+        passed = checkTreeTraversals() && passed;
+        passed = checkOrderStatistics() && passed;
+        passed = checkTreeBounds() && passed;
+        passed = checkBulkLoad() && passed;
+        return passed;
+    }
+
+    bool runDateTest()
+    {
+        bool passed = checkDateTimePacking();
+        passed = checkDateNumbers() && passed;
+        return passed;
+    }
+
+    bool runMapTest()
+    {
+        return checkMapBackends();
+    }
+
+    bool runKernelTest()
+    {
+        return checkKernelDispatch();
+    }
+
+    bool runStatisticsTest()
+    {
+        return checkCoMomentMerge();
+    }
+
+    bool runAll()
+    {
+        bool passed = runHeaderTest();
+        passed = runFollowModeTest() && passed;
+        passed = runInterruptedAppendTest() && passed;
+        passed = runPercentileTest() && passed;
+        passed = runMonthQueryTest() && passed;
+        passed = runCorrelationTest() && passed;
+        passed = runBstTest() && passed;
+        passed = runDateTest() && passed;
+        passed = runMapTest() && passed;
+        passed = runKernelTest() && passed;
+        passed = runStatisticsTest() && passed;
+        std::cout << (passed ? "All self-tests passed." : "Some self-tests FAILED.") << std::endl;
+        return passed;
+    }
+}
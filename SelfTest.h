@@ -0,0 +1,71 @@
+#ifndef SELFTEST_H
+#define SELFTEST_H
+
+/// Checks of the loader and statistics against known answers, run with
+/// the --self-test command-line option. Each check works on its own files
+/// in a temporary directory and prints PASS or FAIL with what it saw.
+namespace SelfTest
+{
+    /// Rows read through headers with reordered, extra, padded, relabelled
+    /// and missing columns, against the values written into them.
+    bool runHeaderTest();
+
+    /// A file whose last line is half written when it is loaded: the row
+    /// must be read once the line is finished and a refresh runs, in memory
+    /// and in a segment store. A file read in bounded batches must give the
+    /// same rows as one read of the whole file.
+    bool runFollowModeTest();
+
+    /// A segment store left mid-load by a crash, before and after the load
+    /// committed: loading the same file again must not store a row twice.
+    /// The load must append to the segment rather than rewrite its rows.
+    bool runInterruptedAppendTest();
+
+    /// Monthly median, p5 and p95 of every measured field against the exact
+    /// ranks of the values, in memory and in a segment store.
+    bool runPercentileTest();
+
+    /// The rows of each month of every year, loaded from CSV files, from a
+    /// snapshot, into a segment store and from the store reopened, against
+    /// the rows written; and the years and total row count of each. The
+    /// partitions read back from a snapshot, or rebuilt when its index is
+    /// damaged, must answer exactly as those of the load that wrote it.
+    bool runMonthQueryTest();
+
+    /// Correlation matrices of S, T and extra columns kept with
+    /// setExtraColumns, over a month and a range, loaded from CSV files, a
+    /// snapshot, a segment store and the store reopened, against a two-pass
+    /// reference on the rows written.
+    bool runCorrelationTest();
+
+    /// Bst against std::set on ascending, descending and scattered keys:
+    /// contents, lookups, and height within the AVL bound. Copies, moves
+    /// and emplaced values keep the right contents, iterators and visitors
+    /// walk the values in the right order, rank, select and countInRange
+    /// agree with positions in the sorted values, lookups, bounds and range
+    /// visits agree with std::set, and so do trees bulk-loaded in batches.
+    bool runBstTest();
+
+    /// DateTime for every day of 1900-2100 against a day-by-day count:
+    /// packed minutes, unpacking, ordering and times of day, and each
+    /// Date's day number, formatted text and parsed value.
+    bool runDateTest();
+
+    /// Each Map backend against std::map: insert, findOrInsert, lookups of
+    /// present and missing keys, at() on a missing key, and iteration,
+    /// which can update values but not keys.
+    bool runMapTest();
+
+    /// Each StatKernels reduction at every ISA level the CPU supports,
+    /// against a plain loop within the rounding bound in StatKernels.h.
+    bool runKernelTest();
+
+    /// Statistics::CoMoments added pair by pair, in blocks and merged from
+    /// partial results, against a two-pass reference on badly centred data.
+    bool runStatisticsTest();
+
+    /// Every check above; true if all of them pass.
+    bool runAll();
+}
+
+#endif // SELFTEST_H
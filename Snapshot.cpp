@@ -0,0 +1,269 @@
+#include "Snapshot.h"
+#include "WeatherData.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <type_traits>
+
+namespace
+{
+    const char SNAPSHOT_MAGIC[8] = {'W', 'X', 'S', 'N', 'A', 'P', '\0', '\0'};
+
+    struct SnapshotHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t fileCount;
+        std::uint64_t recordCount;
+        std::uint64_t fingerprintBytes;
+        std::uint32_t extraColumnCount;
+        std::uint32_t extraNameBytes;
+        std::uint64_t partitionBytes;
+    };
+
+    // Timestamps are stored as the minutes DateTime holds, and mapped back as DateTimes
+    static_assert(sizeof(DateTime) == sizeof(std::int64_t) && std::is_trivially_copyable<DateTime>::value,
+                  "DateTime must be stored as its int64 minutes");
+
+    std::size_t padTo8(std::size_t bytes) {
+        return (bytes + 7) & ~static_cast<std::size_t>(7);
+    }
+
+    void writePadding(std::ofstream& out, std::size_t written) {
+        static const char zeros[8] = {0};
+        out.write(zeros, padTo8(written) - written);
+    }
+
+    template <class T>
+    void appendValue(std::string& blob, const T& value) {
+        blob.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <class T>
+    void writeArray(std::ofstream& out, const T* values, std::size_t count) {
+        std::size_t bytes = count * sizeof(T);
+        if (bytes > 0) {
+            out.write(reinterpret_cast<const char*>(values), bytes);
+        }
+        writePadding(out, bytes);
+    }
+
+    std::uint64_t rotateLeft(std::uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+}
+
+Snapshot::Snapshot()
+    : file(), recordCount(0), extraCount(0), timestamps(nullptr), windSpeeds(nullptr), temperatures(nullptr),
+      solarRadiations(nullptr), extras(nullptr), partitions(nullptr), partitionSize(0) {}
+
+// Word-at-a-time 64-bit hash; fast enough to fingerprint every data file on each load
+std::uint64_t Snapshot::hashBytes(const char* data, std::size_t size) {
+    const std::uint64_t k1 = 0x9E3779B97F4A7C15ULL;
+    const std::uint64_t k2 = 0xC2B2AE3D27D4EB4FULL;
+    std::uint64_t hash = k2 ^ (size * k1);
+
+    // An empty file maps to no memory; data may be null
+    if (size == 0) {
+        return hash;
+    }
+
+    std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = rotateLeft(hash ^ (word * k1), 31) * k2;
+    }
+
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, data + i, size - i);
+    hash = rotateLeft(hash ^ (tail * k1), 31) * k2;
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+bool Snapshot::fingerprintFiles(const std::vector<std::string>& filenames,
+                                std::vector<FileFingerprint>& fingerprints) {
+    fingerprints.clear();
+
+    for (const std::string& filename : filenames) {
+        struct stat fileInfo;
+        if (stat(filename.c_str(), &fileInfo) != 0) {
+            return false;
+        }
+
+        MappedFile dataFile;
+        if (!dataFile.open(filename)) {
+            return false;
+        }
+
+        FileFingerprint fingerprint;
+        fingerprint.path = filename;
+        fingerprint.size = dataFile.size();
+        fingerprint.modifiedTime = static_cast<std::int64_t>(fileInfo.st_mtime);
+        fingerprint.contentHash = hashBytes(dataFile.data(), dataFile.size());
+        fingerprints.push_back(fingerprint);
+    }
+    return true;
+}
+
+std::string Snapshot::serializeFingerprints(const std::vector<FileFingerprint>& fingerprints) {
+    std::string blob;
+    for (const FileFingerprint& fingerprint : fingerprints) {
+        appendValue(blob, static_cast<std::uint32_t>(fingerprint.path.size()));
+        blob += fingerprint.path;
+        appendValue(blob, fingerprint.size);
+        appendValue(blob, fingerprint.modifiedTime);
+        appendValue(blob, fingerprint.contentHash);
+    }
+    return blob;
+}
+
+std::string Snapshot::serializeNames(const std::vector<std::string>& names) {
+    std::string blob;
+    for (const std::string& name : names) {
+        appendValue(blob, static_cast<std::uint32_t>(name.size()));
+        blob += name;
+    }
+    return blob;
+}
+
+bool Snapshot::write(const std::string& path, const std::vector<FileFingerprint>& fingerprints,
+                     const WeatherColumns& columns, const std::vector<std::string>& extraColumns,
+                     const std::string& partitionIndex) {
+    if (columns.getExtraCount() != extraColumns.size()) {
+        return false;
+    }
+
+    std::string fingerprintBlob = serializeFingerprints(fingerprints);
+    std::string nameBlob = serializeNames(extraColumns);
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = VERSION;
+    header.fileCount = static_cast<std::uint32_t>(fingerprints.size());
+    header.recordCount = columns.size();
+    header.fingerprintBytes = fingerprintBlob.size();
+    header.extraColumnCount = static_cast<std::uint32_t>(extraColumns.size());
+    header.extraNameBytes = static_cast<std::uint32_t>(nameBlob.size());
+    header.partitionBytes = partitionIndex.size();
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(fingerprintBlob.data(), fingerprintBlob.size());
+        writePadding(out, fingerprintBlob.size());
+        out.write(nameBlob.data(), nameBlob.size());
+        writePadding(out, nameBlob.size());
+        Span<DateTime> timestampValues = columns.timestamps();
+        Span<double> extraValues = columns.extraValues();
+        writeArray(out, timestampValues.data(), timestampValues.size());
+        writeArray(out, columns.windSpeedData(), columns.size());
+        writeArray(out, columns.temperatureData(), columns.size());
+        writeArray(out, columns.solarRadiationData(), columns.size());
+        writeArray(out, extraValues.data(), extraValues.size());
+        writeArray(out, partitionIndex.data(), partitionIndex.size());
+
+        if (!out.good()) {
+            out.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    std::remove(path.c_str()); // rename does not replace an existing file on Windows
+    return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool Snapshot::open(const std::string& path, const std::vector<FileFingerprint>& expected,
+                    const std::vector<std::string>& extraColumns) {
+    close();
+
+    if (!file.open(path) || file.size() < sizeof(SnapshotHeader)) {
+        close();
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != VERSION || header.fileCount != expected.size() ||
+        header.extraColumnCount != extraColumns.size()) {
+        close();
+        return false;
+    }
+
+    std::size_t n = static_cast<std::size_t>(header.recordCount);
+    std::size_t fingerprintStart = sizeof(SnapshotHeader);
+    std::size_t namesStart = fingerprintStart + padTo8(header.fingerprintBytes);
+    std::size_t timestampsStart = namesStart + padTo8(header.extraNameBytes);
+    std::size_t windStart = timestampsStart + n * sizeof(std::int64_t);
+    std::size_t temperatureStart = windStart + n * sizeof(double);
+    std::size_t solarStart = temperatureStart + n * sizeof(double);
+    std::size_t extraStart = solarStart + n * sizeof(double);
+    std::size_t partitionStart = extraStart + n * extraColumns.size() * sizeof(double);
+    std::size_t expectedSize = partitionStart + padTo8(header.partitionBytes);
+
+    if (file.size() != expectedSize) {
+        close();
+        return false;
+    }
+
+    std::string currentBlob = serializeFingerprints(expected);
+    if (currentBlob.size() != header.fingerprintBytes ||
+        std::memcmp(currentBlob.data(), file.data() + fingerprintStart, currentBlob.size()) != 0) {
+        close();
+        return false;
+    }
+    std::string nameBlob = serializeNames(extraColumns);
+    if (nameBlob.size() != header.extraNameBytes ||
+        std::memcmp(nameBlob.data(), file.data() + namesStart, nameBlob.size()) != 0) {
+        close();
+        return false;
+    }
+
+    const char* base = file.data();
+    recordCount = n;
+    extraCount = extraColumns.size();
+    timestamps = reinterpret_cast<const DateTime*>(base + timestampsStart);
+    windSpeeds = reinterpret_cast<const double*>(base + windStart);
+    temperatures = reinterpret_cast<const double*>(base + temperatureStart);
+    solarRadiations = reinterpret_cast<const double*>(base + solarStart);
+    extras = reinterpret_cast<const double*>(base + extraStart);
+    partitions = base + partitionStart;
+    partitionSize = static_cast<std::size_t>(header.partitionBytes);
+    return true;
+}
+
+void Snapshot::close() {
+    file.close();
+    recordCount = 0;
+    extraCount = 0;
+    timestamps = nullptr;
+    windSpeeds = nullptr;
+    temperatures = nullptr;
+    solarRadiations = nullptr;
+    extras = nullptr;
+    partitions = nullptr;
+    partitionSize = 0;
+}
+
+std::size_t Snapshot::getRecordCount() const { return recordCount; }
+
+RecordSlice Snapshot::records() const {
+    return RecordSlice{timestamps, windSpeeds, temperatures, solarRadiations, recordCount, extras, extraCount, 1};
+}
+
+const char* Snapshot::partitionData() const { return partitions; }
+
+std::size_t Snapshot::partitionBytes() const { return partitionSize; }
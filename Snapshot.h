@@ -0,0 +1,85 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class DateTime;
+class WeatherColumns;
+struct RecordSlice;
+
+/// @struct FileFingerprint
+/// @brief Identity of a data file at the time a snapshot was written
+struct FileFingerprint {
+    std::string path;
+    std::uint64_t size = 0;
+    std::int64_t modifiedTime = 0;
+    std::uint64_t contentHash = 0;
+};
+
+/// @class Snapshot
+/// @brief Versioned binary column snapshot of loaded weather data
+///
+/// Layout (native byte order, every section 8-byte aligned):
+///   header | fingerprints | extra column names | timestamp[n] (int64 minutes since 1/1/1970) |
+///   windSpeed[n] | temperature[n] | solarRadiation[n] | extra values[n * extra columns], row by row |
+///   partition index (see WeatherDataCollection::encodePartitions)
+///
+/// A snapshot is only used when its stored fingerprints (size, modification
+/// time and content hash of every listed file, in list order) match the
+/// current files exactly, and it holds the extra columns asked for.
+class Snapshot {
+public:
+    // 2: minute timestamps replace yyyymmdd dates; 3: month index dropped (partitions are rebuilt from the rows);
+    // 4: extra columns; 5: partitions (runs, row counts and aggregates) stored with the rows
+    static const std::uint32_t VERSION = 5;
+
+    Snapshot();
+
+    /// Map the snapshot at path and check it against the expected fingerprints
+    /// and extra columns.
+    /// @return false if the file is missing, corrupt, of another version or stale
+    bool open(const std::string& path, const std::vector<FileFingerprint>& expected,
+              const std::vector<std::string>& extraColumns = {});
+    void close();
+
+    std::size_t getRecordCount() const;
+
+    // Mapped sections (valid while the snapshot is open)
+    RecordSlice records() const; // every row, with the extra columns
+    const char* partitionData() const;
+    std::size_t partitionBytes() const;
+
+    /// Write the rows of columns, which hold the values of extraColumns, and
+    /// the encoded partition index of those rows as a snapshot to path. The
+    /// file is written next to path and renamed into place when complete.
+    static bool write(const std::string& path, const std::vector<FileFingerprint>& fingerprints,
+                      const WeatherColumns& columns, const std::vector<std::string>& extraColumns,
+                      const std::string& partitionIndex);
+
+    /// Compute size, modification time and content hash of each file.
+    /// @return false if any file cannot be read
+    static bool fingerprintFiles(const std::vector<std::string>& filenames,
+                                 std::vector<FileFingerprint>& fingerprints);
+
+    static std::uint64_t hashBytes(const char* data, std::size_t size);
+
+private:
+    MappedFile file;
+    std::size_t recordCount;
+    std::size_t extraCount;
+    const DateTime* timestamps;
+    const double* windSpeeds;
+    const double* temperatures;
+    const double* solarRadiations;
+    const double* extras;
+    const char* partitions;
+    std::size_t partitionSize;
+
+    static std::string serializeFingerprints(const std::vector<FileFingerprint>& fingerprints);
+    static std::string serializeNames(const std::vector<std::string>& names);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,33 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cstddef>
+#include <vector>
+
+/// @class Span
+/// @brief Non-owning view of count contiguous values (std::span arrives in C++20)
+///
+/// A Span never copies or frees what it points at; it is only valid while
+/// the storage it was taken from is alive and unchanged.
+template <class T>
+class Span {
+private:
+    const T* first;
+    std::size_t count;
+
+public:
+    Span() : first(nullptr), count(0) {}
+    Span(const T* data, std::size_t size) : first(data), count(size) {}
+    Span(const std::vector<T>& values) : first(values.data()), count(values.size()) {}
+
+    const T* data() const { return first; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    const T& operator[](std::size_t i) const { return first[i]; }
+
+    const T* begin() const { return first; }
+    const T* end() const { return first + count; }
+};
+
+#endif // SPAN_H
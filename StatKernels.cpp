@@ -0,0 +1,344 @@
+#include "StatKernels.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STATKERNELS_X86 1
+#endif
+
+namespace
+{
+    using StatKernels::IsaLevel;
+    using StatKernels::CenteredSums;
+
+    // Plain loops with one accumulator: the reference results, and the
+    // fallback on every other platform
+    double sumScalar(const double* x, std::size_t n) {
+        double total = 0.0;
+        for (std::size_t i = 0; i < n; i++) total += x[i];
+        return total;
+    }
+
+    double sumSquaredDeviationsScalar(const double* x, std::size_t n, double mean) {
+        double total = 0.0;
+        for (std::size_t i = 0; i < n; i++) total += (x[i] - mean) * (x[i] - mean);
+        return total;
+    }
+
+    double sumAbsDeviationsScalar(const double* x, std::size_t n, double mean) {
+        double total = 0.0;
+        for (std::size_t i = 0; i < n; i++) total += std::abs(x[i] - mean);
+        return total;
+    }
+
+    CenteredSums centeredPairSumsScalar(const double* x, const double* y, std::size_t n, double meanX,
+                                        double meanY) {
+        CenteredSums sums;
+        for (std::size_t i = 0; i < n; i++) {
+            double dx = x[i] - meanX;
+            double dy = y[i] - meanY;
+            sums.sumDX2 += dx * dx;
+            sums.sumDY2 += dy * dy;
+            sums.sumDXDY += dx * dy;
+        }
+        return sums;
+    }
+
+    double centeredCrossSumScalar(const double* x, const double* y, std::size_t n, double meanX, double meanY) {
+        double total = 0.0;
+        for (std::size_t i = 0; i < n; i++) total += (x[i] - meanX) * (y[i] - meanY);
+        return total;
+    }
+
+#ifdef STATKERNELS_X86
+    // The vector kernels are written once, over GCC vector types, and are
+    // compiled for each instruction set by inlining them into the
+    // target-specific wrappers further down. Vec holds W doubles; Bits is the
+    // integer vector of the same size, used to clear sign bits.
+    typedef double V2 __attribute__((vector_size(16)));
+    typedef double V4 __attribute__((vector_size(32)));
+    typedef double V8 __attribute__((vector_size(64)));
+    typedef long long B2 __attribute__((vector_size(16)));
+    typedef long long B4 __attribute__((vector_size(32)));
+    typedef long long B8 __attribute__((vector_size(64)));
+
+#define KERNEL inline __attribute__((always_inline))
+
+    template <class Vec>
+    KERNEL double lanesTotal(const Vec& v) {
+        double total = 0.0;
+        for (std::size_t lane = 0; lane < sizeof(Vec) / sizeof(double); lane++) total += v[lane];
+        return total;
+    }
+
+    // Unaligned load of one vector starting at p
+    template <class Vec>
+    KERNEL void loadVec(Vec& v, const double* p) {
+        __builtin_memcpy(&v, p, sizeof(Vec));
+    }
+
+    template <class Vec>
+    KERNEL double sumVector(const double* x, std::size_t n) {
+        const std::size_t W = sizeof(Vec) / sizeof(double);
+        Vec a0 = {}, a1 = {}, a2 = {}, a3 = {}, v0, v1, v2, v3;
+        std::size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W) {
+            loadVec(v0, x + i);
+            loadVec(v1, x + i + W);
+            loadVec(v2, x + i + 2 * W);
+            loadVec(v3, x + i + 3 * W);
+            a0 += v0;
+            a1 += v1;
+            a2 += v2;
+            a3 += v3;
+        }
+        Vec all = (a0 + a1) + (a2 + a3);
+        double total = lanesTotal(all);
+        for (; i < n; i++) total += x[i];
+        return total;
+    }
+
+    template <class Vec>
+    KERNEL double sumSquaredDeviationsVector(const double* x, std::size_t n, double mean) {
+        const std::size_t W = sizeof(Vec) / sizeof(double);
+        Vec m = Vec{} + mean;
+        Vec a0 = {}, a1 = {}, a2 = {}, a3 = {}, v0, v1, v2, v3;
+        std::size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W) {
+            loadVec(v0, x + i);
+            loadVec(v1, x + i + W);
+            loadVec(v2, x + i + 2 * W);
+            loadVec(v3, x + i + 3 * W);
+            v0 -= m;
+            v1 -= m;
+            v2 -= m;
+            v3 -= m;
+            a0 += v0 * v0;
+            a1 += v1 * v1;
+            a2 += v2 * v2;
+            a3 += v3 * v3;
+        }
+        Vec all = (a0 + a1) + (a2 + a3);
+        double total = lanesTotal(all);
+        for (; i < n; i++) total += (x[i] - mean) * (x[i] - mean);
+        return total;
+    }
+
+    template <class Vec, class Bits>
+    KERNEL double sumAbsDeviationsVector(const double* x, std::size_t n, double mean) {
+        const std::size_t W = sizeof(Vec) / sizeof(double);
+        const Bits noSign = Bits{} + 0x7FFFFFFFFFFFFFFFLL;
+        Vec m = Vec{} + mean;
+        Vec a0 = {}, a1 = {}, a2 = {}, a3 = {}, v0, v1, v2, v3;
+        std::size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W) {
+            loadVec(v0, x + i);
+            loadVec(v1, x + i + W);
+            loadVec(v2, x + i + 2 * W);
+            loadVec(v3, x + i + 3 * W);
+            a0 += reinterpret_cast<Vec>(reinterpret_cast<Bits>(v0 - m) & noSign);
+            a1 += reinterpret_cast<Vec>(reinterpret_cast<Bits>(v1 - m) & noSign);
+            a2 += reinterpret_cast<Vec>(reinterpret_cast<Bits>(v2 - m) & noSign);
+            a3 += reinterpret_cast<Vec>(reinterpret_cast<Bits>(v3 - m) & noSign);
+        }
+        Vec all = (a0 + a1) + (a2 + a3);
+        double total = lanesTotal(all);
+        for (; i < n; i++) total += std::abs(x[i] - mean);
+        return total;
+    }
+
+    // Three sums at once, two accumulators each
+    template <class Vec>
+    KERNEL CenteredSums centeredPairSumsVector(const double* x, const double* y, std::size_t n, double meanX,
+                                               double meanY) {
+        const std::size_t W = sizeof(Vec) / sizeof(double);
+        Vec mx = Vec{} + meanX, my = Vec{} + meanY;
+        Vec xx0 = {}, yy0 = {}, xy0 = {}, xx1 = {}, yy1 = {}, xy1 = {};
+        Vec x0, y0, x1, y1;
+        std::size_t i = 0;
+        for (; i + 2 * W <= n; i += 2 * W) {
+            loadVec(x0, x + i);
+            loadVec(y0, y + i);
+            loadVec(x1, x + i + W);
+            loadVec(y1, y + i + W);
+            x0 -= mx;
+            y0 -= my;
+            x1 -= mx;
+            y1 -= my;
+            xx0 += x0 * x0;
+            yy0 += y0 * y0;
+            xy0 += x0 * y0;
+            xx1 += x1 * x1;
+            yy1 += y1 * y1;
+            xy1 += x1 * y1;
+        }
+
+        CenteredSums sums;
+        Vec all = xx0 + xx1;
+        sums.sumDX2 = lanesTotal(all);
+        all = yy0 + yy1;
+        sums.sumDY2 = lanesTotal(all);
+        all = xy0 + xy1;
+        sums.sumDXDY = lanesTotal(all);
+
+        for (; i < n; i++) {
+            double dx = x[i] - meanX;
+            double dy = y[i] - meanY;
+            sums.sumDX2 += dx * dx;
+            sums.sumDY2 += dy * dy;
+            sums.sumDXDY += dx * dy;
+        }
+        return sums;
+    }
+
+    template <class Vec>
+    KERNEL double centeredCrossSumVector(const double* x, const double* y, std::size_t n, double meanX,
+                                         double meanY) {
+        const std::size_t W = sizeof(Vec) / sizeof(double);
+        Vec mx = Vec{} + meanX, my = Vec{} + meanY;
+        Vec a0 = {}, a1 = {}, a2 = {}, a3 = {}, x0, x1, x2, x3, y0, y1, y2, y3;
+        std::size_t i = 0;
+        for (; i + 4 * W <= n; i += 4 * W) {
+            loadVec(x0, x + i);
+            loadVec(x1, x + i + W);
+            loadVec(x2, x + i + 2 * W);
+            loadVec(x3, x + i + 3 * W);
+            loadVec(y0, y + i);
+            loadVec(y1, y + i + W);
+            loadVec(y2, y + i + 2 * W);
+            loadVec(y3, y + i + 3 * W);
+            a0 += (x0 - mx) * (y0 - my);
+            a1 += (x1 - mx) * (y1 - my);
+            a2 += (x2 - mx) * (y2 - my);
+            a3 += (x3 - mx) * (y3 - my);
+        }
+        Vec all = (a0 + a1) + (a2 + a3);
+        double total = lanesTotal(all);
+        for (; i < n; i++) total += (x[i] - meanX) * (y[i] - meanY);
+        return total;
+    }
+
+#undef KERNEL
+
+#define STATKERNELS_WRAPPERS(SUFFIX, TARGET, VEC, BITS)                                                 \
+    __attribute__((target(TARGET))) double sum##SUFFIX(const double* x, std::size_t n) {                \
+        return sumVector<VEC>(x, n);                                                                    \
+    }                                                                                                   \
+    __attribute__((target(TARGET))) double sumSquaredDeviations##SUFFIX(const double* x, std::size_t n, \
+                                                                        double mean) {                  \
+        return sumSquaredDeviationsVector<VEC>(x, n, mean);                                             \
+    }                                                                                                   \
+    __attribute__((target(TARGET))) double sumAbsDeviations##SUFFIX(const double* x, std::size_t n,     \
+                                                                    double mean) {                      \
+        return sumAbsDeviationsVector<VEC, BITS>(x, n, mean);                                           \
+    }                                                                                                   \
+    __attribute__((target(TARGET))) CenteredSums centeredPairSums##SUFFIX(                              \
+        const double* x, const double* y, std::size_t n, double meanX, double meanY) {                  \
+        return centeredPairSumsVector<VEC>(x, y, n, meanX, meanY);                                      \
+    }                                                                                                   \
+    __attribute__((target(TARGET))) double centeredCrossSum##SUFFIX(                                    \
+        const double* x, const double* y, std::size_t n, double meanX, double meanY) {                  \
+        return centeredCrossSumVector<VEC>(x, y, n, meanX, meanY);                                      \
+    }
+
+    STATKERNELS_WRAPPERS(SSE2, "sse2", V2, B2)
+    STATKERNELS_WRAPPERS(AVX2, "avx2", V4, B4)
+    STATKERNELS_WRAPPERS(AVX512, "avx512f", V8, B8)
+
+#undef STATKERNELS_WRAPPERS
+#endif // STATKERNELS_X86
+
+    struct KernelSet {
+        double (*sum)(const double*, std::size_t);
+        double (*sumSquaredDeviations)(const double*, std::size_t, double);
+        double (*sumAbsDeviations)(const double*, std::size_t, double);
+        CenteredSums (*centeredPairSums)(const double*, const double*, std::size_t, double, double);
+        double (*centeredCrossSum)(const double*, const double*, std::size_t, double, double);
+    };
+
+    const KernelSet& kernelsFor(IsaLevel level) {
+        static const KernelSet scalar = {sumScalar, sumSquaredDeviationsScalar, sumAbsDeviationsScalar,
+                                         centeredPairSumsScalar, centeredCrossSumScalar};
+#ifdef STATKERNELS_X86
+        static const KernelSet sse2 = {sumSSE2, sumSquaredDeviationsSSE2, sumAbsDeviationsSSE2,
+                                       centeredPairSumsSSE2, centeredCrossSumSSE2};
+        static const KernelSet avx2 = {sumAVX2, sumSquaredDeviationsAVX2, sumAbsDeviationsAVX2,
+                                       centeredPairSumsAVX2, centeredCrossSumAVX2};
+        static const KernelSet avx512 = {sumAVX512, sumSquaredDeviationsAVX512, sumAbsDeviationsAVX512,
+                                         centeredPairSumsAVX512, centeredCrossSumAVX512};
+        switch (level) {
+        case IsaLevel::SSE2: return sse2;
+        case IsaLevel::AVX2: return avx2;
+        case IsaLevel::AVX512: return avx512;
+        default: break;
+        }
+#endif
+        (void)level;
+        return scalar;
+    }
+
+    // The level in use and its kernels, chosen on first use
+    struct Dispatch {
+        IsaLevel level;
+        const KernelSet* kernels;
+    };
+
+    Dispatch& dispatch() {
+        static Dispatch current = {StatKernels::detectIsaLevel(), &kernelsFor(StatKernels::detectIsaLevel())};
+        return current;
+    }
+}
+
+namespace StatKernels
+{
+    IsaLevel detectIsaLevel() {
+#ifdef STATKERNELS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return IsaLevel::AVX512;
+        if (__builtin_cpu_supports("avx2")) return IsaLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return IsaLevel::SSE2;
+#endif
+        return IsaLevel::Scalar;
+    }
+
+    IsaLevel getIsaLevel() {
+        return dispatch().level;
+    }
+
+    void setIsaLevel(IsaLevel level) {
+        IsaLevel best = detectIsaLevel();
+        if (static_cast<int>(level) > static_cast<int>(best)) {
+            level = best;
+        }
+        dispatch().level = level;
+        dispatch().kernels = &kernelsFor(level);
+    }
+
+    const char* isaName(IsaLevel level) {
+        switch (level) {
+        case IsaLevel::SSE2: return "SSE2";
+        case IsaLevel::AVX2: return "AVX2";
+        case IsaLevel::AVX512: return "AVX-512";
+        default: return "scalar";
+        }
+    }
+
+    double sum(const double* x, std::size_t n) {
+        return dispatch().kernels->sum(x, n);
+    }
+
+    double sumSquaredDeviations(const double* x, std::size_t n, double mean) {
+        return dispatch().kernels->sumSquaredDeviations(x, n, mean);
+    }
+
+    double sumAbsDeviations(const double* x, std::size_t n, double mean) {
+        return dispatch().kernels->sumAbsDeviations(x, n, mean);
+    }
+
+    CenteredSums centeredPairSums(const double* x, const double* y, std::size_t n, double meanX, double meanY) {
+        return dispatch().kernels->centeredPairSums(x, y, n, meanX, meanY);
+    }
+
+    double centeredCrossSum(const double* x, const double* y, std::size_t n, double meanX, double meanY) {
+        return dispatch().kernels->centeredCrossSum(x, y, n, meanX, meanY);
+    }
+}
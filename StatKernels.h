@@ -0,0 +1,46 @@
+#ifndef STATKERNELS_H
+#define STATKERNELS_H
+
+#include <cstddef>
+
+/// Reduction kernels behind the Statistics functions, vectorised per
+/// instruction set and picked at run time from the CPU's features.
+///
+/// The vector versions keep four independent accumulators per quantity and
+/// add them together at the end, so they sum in a different order from the
+/// scalar loop. Results then differ from the scalar version by rounding only:
+/// for a sum of n terms t[i], |vector - scalar| <= 2 * n * DBL_EPSILON * sum |t[i]|
+/// (the usual bound for reordered floating-point summation). On our data
+/// that is far below the 6 significant digits the reports print.
+///
+/// On non-x86 builds, or compilers without GCC-style target attributes,
+/// only the scalar kernels exist.
+namespace StatKernels
+{
+    enum class IsaLevel { Scalar, SSE2, AVX2, AVX512 };
+
+    /// Sums of products of deviations from given means, for co-moments
+    struct CenteredSums {
+        double sumDX2 = 0.0;  // sum (x - meanX)^2
+        double sumDY2 = 0.0;  // sum (y - meanY)^2
+        double sumDXDY = 0.0; // sum (x - meanX)(y - meanY)
+    };
+
+    /// Best level this CPU (and build) supports
+    IsaLevel detectIsaLevel();
+
+    /// Level the kernels currently use; starts at detectIsaLevel().
+    /// setIsaLevel is clamped to what is supported (for benchmarks and checks).
+    IsaLevel getIsaLevel();
+    void setIsaLevel(IsaLevel level);
+    const char* isaName(IsaLevel level);
+
+    double sum(const double* x, std::size_t n);
+    double sumSquaredDeviations(const double* x, std::size_t n, double mean); // sum (x - mean)^2
+    double sumAbsDeviations(const double* x, std::size_t n, double mean);     // sum |x - mean|
+    CenteredSums centeredPairSums(const double* x, const double* y, std::size_t n, double meanX, double meanY);
+    double centeredCrossSum(const double* x, const double* y, std::size_t n, double meanX,
+                            double meanY); // sum (x - meanX)(y - meanY)
+}
+
+#endif // STATKERNELS_H
@@ -1,4 +1,8 @@
 #include "WeatherData.h"
+#include "MappedFile.h"
+#include "MetDataParser.h"
+#include "Snapshot.h"
+#include "StatKernels.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -6,198 +10,815 @@
 #include <algorithm>
 #include <numeric>
 #include <stdexcept>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <limits>
+
+namespace
+{
+    // Bytes of a data file parsed at a time when loading into a segment store
+    const std::size_t SEGMENT_LOAD_BYTES = std::size_t(16) << 20;
+
+    /// Buffers rows column by column and hands them to a CoMomentMatrix a block at a time
+    class RowBlock {
+    private:
+        static const std::size_t ROWS = 512;
+
+        Statistics::CoMomentMatrix& matrix;
+        std::vector<double> values; // ROWS values per column
+        std::vector<const double*> columns;
+        std::size_t rows;
+
+    public:
+        explicit RowBlock(Statistics::CoMomentMatrix& target)
+            : matrix(target), values(target.getColumnCount() * ROWS), columns(target.getColumnCount()), rows(0) {
+            for (std::size_t c = 0; c < columns.size(); c++) columns[c] = values.data() + c * ROWS;
+        }
+
+        void add(const double* row) {
+            for (std::size_t c = 0; c < columns.size(); c++) values[c * ROWS + rows] = row[c];
+            if (++rows == ROWS) flush();
+        }
+
+        void flush() {
+            if (rows > 0) matrix.addBlock(columns.data(), rows);
+            rows = 0;
+        }
+    };
+
+    // Raw bytes of trivially copyable values, for the partition index of a snapshot
+    template <class T>
+    void appendBytes(std::string& blob, const T& value) {
+        blob.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <class T>
+    bool readBytes(const char*& pos, const char* end, T& value) {
+        if (static_cast<std::size_t>(end - pos) < sizeof(T)) return false;
+        std::memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+}
+
+namespace
+{
+    /// One year of the option 4 report; months[m] is nullptr for a month with no data
+    void writeMonthlyStats(std::ostream& file, int year, const PartitionAggregate* const months[12])
+    {
+        // Write the year header exactly as specified
+        file << year << std::endl;
+
+        std::string monthNames[] = {"January", "February", "March", "April", "May", "June",
+                                   "July", "August", "September", "October", "November", "December"};
+
+        for (int month = 1; month <= 12; month++)
+        {
+            const PartitionAggregate* aggregate = months[month - 1];
+            if (aggregate == nullptr)
+            {
+                // Write empty data for months with no data
+                file << monthNames[month-1] << ",0.0(0.0, 0.0),0.0(0.0, 0.0),0.0" << std::endl;
+                continue;
+            }
+
+            double avgWind = aggregate->windSpeed.mean();
+            double avgTemp = aggregate->temperature.mean();
+            double stdWind = aggregate->windSpeed.stdDev();
+            double stdTemp = aggregate->temperature.stdDev();
+            double madWind = aggregate->windSpeedMAD;
+            double madTemp = aggregate->temperatureMAD;
+            double totalSolar = aggregate->totalSolar;
+
+            // Write in EXACT format: Month,AvgWS(std,mad),AvgTemp(std,mad),TotalSolar
+            file << monthNames[month-1] << ","
+                 << avgWind << "(" << stdWind << ", " << madWind << "),"
+                 << avgTemp << "(" << stdTemp << ", " << madTemp << "),"
+                 << totalSolar << std::endl;
+        }
+    }
+}
 
 // WeatherRecord implementation
-WeatherRecord::WeatherRecord(const Date& d, double ws, double temp, double sr)
-    : date(d), windSpeed(ws), temperature(temp), solarRadiation(sr) {}
+WeatherRecord::WeatherRecord(const DateTime& ts, double ws, double temp, double sr)
+    : timestamp(ts), windSpeed(ws), temperature(temp), solarRadiation(sr) {}
 
 bool WeatherRecord::operator<(const WeatherRecord& other) const {
-    return date < other.date;
+    return timestamp < other.timestamp;
 }
 
 bool WeatherRecord::operator>(const WeatherRecord& other) const {
-    return date > other.date;
+    return timestamp > other.timestamp;
 }
 
 bool WeatherRecord::operator==(const WeatherRecord& other) const {
-    return date == other.date;
+    return timestamp == other.timestamp;
 }
 
 std::ostream& operator<<(std::ostream& os, const WeatherRecord& wr) {
-    os << wr.date << " | WS: " << wr.windSpeed << " | Temp: " << wr.temperature
+    os << wr.timestamp << " | WS: " << wr.windSpeed << " | Temp: " << wr.temperature
        << " | Solar: " << wr.solarRadiation;
     return os;
 }
 
+// WeatherColumns implementation
+WeatherColumns::WeatherColumns()
+    : timestamp(), windSpeed(), temperature(), solarRadiation(), extraCount(0), extra() {}
+
+void WeatherColumns::setExtraCount(std::size_t count) {
+    extraCount = count;
+}
+
+std::size_t WeatherColumns::getExtraCount() const {
+    return extraCount;
+}
+
+std::uint32_t WeatherColumns::append(const WeatherRecord& record, const double* extras) {
+    std::uint32_t row = static_cast<std::uint32_t>(timestamp.size());
+    timestamp.push_back(record.timestamp);
+    windSpeed.push_back(record.windSpeed);
+    temperature.push_back(record.temperature);
+    solarRadiation.push_back(record.solarRadiation);
+    if (extras != nullptr) {
+        extra.insert(extra.end(), extras, extras + extraCount);
+    } else {
+        extra.resize(extra.size() + extraCount, std::numeric_limits<double>::quiet_NaN());
+    }
+    return row;
+}
+
+void WeatherColumns::append(const RecordSlice& rows) {
+    timestamp.insert(timestamp.end(), rows.timestamps, rows.timestamps + rows.size);
+    windSpeed.insert(windSpeed.end(), rows.windSpeeds, rows.windSpeeds + rows.size);
+    temperature.insert(temperature.end(), rows.temperatures, rows.temperatures + rows.size);
+    solarRadiation.insert(solarRadiation.end(), rows.solarRadiations, rows.solarRadiations + rows.size);
+    if (rows.extraRowStride == extraCount && rows.extraColumnStride == 1) {
+        extra.insert(extra.end(), rows.extras, rows.extras + rows.size * extraCount);
+        return;
+    }
+    for (std::size_t row = 0; row < rows.size; row++) {
+        for (std::size_t c = 0; c < extraCount; c++) extra.push_back(rows.extraAt(row, c));
+    }
+}
+
+void WeatherColumns::reserve(std::size_t rows) {
+    timestamp.reserve(rows);
+    windSpeed.reserve(rows);
+    temperature.reserve(rows);
+    solarRadiation.reserve(rows);
+    extra.reserve(rows * extraCount);
+}
+
+std::size_t WeatherColumns::size() const {
+    return timestamp.size();
+}
+
+WeatherRecord WeatherColumns::recordAt(std::uint32_t row) const {
+    return WeatherRecord(timestamp[row], windSpeed[row], temperature[row], solarRadiation[row]);
+}
+
+Span<double> WeatherColumns::column(MeasuredField field) const {
+    switch (field) {
+    case MeasuredField::WindSpeed: return Span<double>(windSpeed);
+    case MeasuredField::Temperature: return Span<double>(temperature);
+    default: return Span<double>(solarRadiation);
+    }
+}
+
+RecordSlice WeatherColumns::slice(std::uint32_t first, std::uint32_t last) const {
+    return RecordSlice{timestamp.data() + first, windSpeed.data() + first, temperature.data() + first,
+                       solarRadiation.data() + first, static_cast<std::size_t>(last - first),
+                       extra.data() + first * extraCount, extraCount, 1};
+}
+
+// RecordSlice implementation
+Span<double> RecordSlice::column(MeasuredField field) const {
+    switch (field) {
+    case MeasuredField::WindSpeed: return Span<double>(windSpeeds, size);
+    case MeasuredField::Temperature: return Span<double>(temperatures, size);
+    default: return Span<double>(solarRadiations, size);
+    }
+}
+
+WeatherRecord RecordSlice::recordAt(std::size_t row) const {
+    return WeatherRecord(timestamps[row], windSpeeds[row], temperatures[row], solarRadiations[row]);
+}
+
+// PartitionAggregate implementation
+void PartitionAggregate::add(double ws, double temp, double sr) {
+    windSpeed.add(ws);
+    temperature.add(temp);
+    totalSolar += sr;
+    windTemperature.add(ws, temp);
+    windSolar.add(ws, sr);
+    temperatureSolar.add(temp, sr);
+    windSpeedQuantiles.add(ws);
+    temperatureQuantiles.add(temp);
+    solarRadiationQuantiles.add(sr);
+    madValid = false;
+}
+
+void PartitionAggregate::add(const RecordSlice& slice) {
+    for (std::size_t row = 0; row < slice.size; row++) {
+        add(slice.windSpeeds[row], slice.temperatures[row], slice.solarRadiations[row]);
+    }
+}
+
+const Statistics::CoMoments& PartitionAggregate::coMoments(MeasuredField x, MeasuredField y) const {
+    if (x != MeasuredField::SolarRadiation && y != MeasuredField::SolarRadiation) return windTemperature;
+    if (x != MeasuredField::Temperature && y != MeasuredField::Temperature) return windSolar;
+    return temperatureSolar;
+}
+
+const Statistics::QuantileSketch& PartitionAggregate::quantiles(MeasuredField field) const {
+    switch (field) {
+    case MeasuredField::WindSpeed: return windSpeedQuantiles;
+    case MeasuredField::Temperature: return temperatureQuantiles;
+    default: return solarRadiationQuantiles;
+    }
+}
+
+Statistics::CoMomentMatrix PartitionAggregate::coMomentMatrix(const std::vector<MeasuredField>& fields) const {
+    auto meanOf = [this](MeasuredField field) {
+        if (field == MeasuredField::WindSpeed) return windTemperature.meanX;
+        return (field == MeasuredField::Temperature) ? windTemperature.meanY : windSolar.meanY;
+    };
+    auto squaresOf = [this](MeasuredField field) {
+        if (field == MeasuredField::WindSpeed) return windTemperature.m2X;
+        return (field == MeasuredField::Temperature) ? windTemperature.m2Y : windSolar.m2Y;
+    };
+
+    std::size_t k = fields.size();
+    std::vector<double> means(k), matrix(k * k);
+    for (std::size_t i = 0; i < k; i++) {
+        means[i] = meanOf(fields[i]);
+        for (std::size_t j = 0; j < k; j++) {
+            matrix[i * k + j] = (fields[i] == fields[j]) ? squaresOf(fields[i]) : coMoments(fields[i], fields[j]).cXY;
+        }
+    }
+
+    Statistics::CoMomentMatrix result(k);
+    result.assign(windSpeed.count, means, matrix);
+    return result;
+}
+
+void PartitionAggregate::write(std::string& blob) const {
+    appendBytes(blob, windSpeed);
+    appendBytes(blob, temperature);
+    appendBytes(blob, totalSolar);
+    appendBytes(blob, windTemperature);
+    appendBytes(blob, windSolar);
+    appendBytes(blob, temperatureSolar);
+    windSpeedQuantiles.write(blob);
+    temperatureQuantiles.write(blob);
+    solarRadiationQuantiles.write(blob);
+}
+
+bool PartitionAggregate::read(const char*& pos, const char* end) {
+    PartitionAggregate loaded;
+    if (!readBytes(pos, end, loaded.windSpeed) || !readBytes(pos, end, loaded.temperature) ||
+        !readBytes(pos, end, loaded.totalSolar) || !readBytes(pos, end, loaded.windTemperature) ||
+        !readBytes(pos, end, loaded.windSolar) || !readBytes(pos, end, loaded.temperatureSolar) ||
+        !loaded.windSpeedQuantiles.read(pos, end) || !loaded.temperatureQuantiles.read(pos, end) ||
+        !loaded.solarRadiationQuantiles.read(pos, end)) {
+        return false;
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+// RecordView implementation
+RecordView::RecordView() : collection(nullptr), year(0), month(0) {}
+
+RecordView::RecordView(const WeatherDataCollection& source, int y, int m) : collection(&source), year(y), month(m) {}
+
+ColumnView RecordView::column(MeasuredField field) const {
+    return ColumnView(*this, field);
+}
+
+std::size_t RecordView::size() const {
+    return (collection != nullptr) ? collection->countRows(year, month) : 0;
+}
+
+// ColumnView implementation
+ColumnView::ColumnView(const RecordView& view, MeasuredField f) : records(view), field(f), values() {}
+
+ColumnView::ColumnView(Span<double> span) : records(), field(MeasuredField::WindSpeed), values(span) {}
+
+ColumnView::ColumnView(const std::vector<double>& data) : ColumnView(Span<double>(data)) {}
+
+std::size_t ColumnView::size() const {
+    return values.size() + records.size();
+}
+
+// RecordIndex implementation
+RecordIndex::RecordIndex() : timestamp(), row(0) {}
+
+RecordIndex::RecordIndex(const DateTime& ts, std::uint32_t r) : timestamp(ts), row(r) {}
+
+bool RecordIndex::operator<(const RecordIndex& other) const {
+    if (timestamp != other.timestamp) return timestamp < other.timestamp;
+    return row < other.row;
+}
+
+bool RecordIndex::operator>(const RecordIndex& other) const {
+    return other < *this;
+}
+
+bool RecordIndex::operator==(const RecordIndex& other) const {
+    return timestamp == other.timestamp && row == other.row;
+}
+
+std::ostream& operator<<(std::ostream& os, const RecordIndex& index) {
+    os << index.timestamp << " #" << index.row;
+    return os;
+}
+
 // WeatherDataCollection implementation
 WeatherDataCollection::WeatherDataCollection()
-    : weatherDataBST(), dataByMonth() {} // Initialize in member list
+    : columns(), weatherDataBST(), partitions(), loadThreadCount(0), snapshotEnabled(true), extraColumns(),
+      segments(), segmentAggregates(), aggregateScans(0), followedSourceFile(), followedOffsets() {} // Initialize in member list
 
 WeatherDataCollection::~WeatherDataCollection() {}
 
 // Add weather record
 void WeatherDataCollection::addWeatherRecord(const WeatherRecord& record)
 {
-    WeatherRecord* recordCopy = new WeatherRecord(record);
+    // The record is stored once, in the columns; the indexes hold its row
+    std::uint32_t row = columns.append(record);
+
+    weatherDataBST.emplace(record.timestamp, row);
+    indexPartition(row);
+}
+
+// Add a batch of records (normally one file, in time order). The timestamp
+// tree is bulk-loaded, taking the batch as one sorted run.
+void WeatherDataCollection::addWeatherRecords(const std::vector<WeatherRecord>& records,
+                                              const std::vector<double>& extraValues)
+{
+    if (records.empty()) return;
+
+    std::uint32_t firstRow = static_cast<std::uint32_t>(columns.size());
+    columns.reserve(columns.size() + records.size());
+
+    std::size_t extraCount = columns.getExtraCount();
+    bool hasExtras = extraValues.size() == records.size() * extraCount;
+    for (std::size_t i = 0; i < records.size(); i++)
+    {
+        indexPartition(columns.append(records[i], hasExtras ? extraValues.data() + i * extraCount : nullptr));
+    }
+
+    bulkIndexDates(firstRow);
+}
+
+// Insert rows [firstRow, end) into the timestamp tree as one batch
+void WeatherDataCollection::bulkIndexDates(std::uint32_t firstRow)
+{
+    std::vector<RecordIndex> indexes;
+    indexes.reserve(columns.size() - firstRow);
 
-    weatherDataBST.insert(record);
+    for (std::uint32_t row = firstRow; row < columns.size(); row++)
+    {
+        indexes.emplace_back(columns.timestampAt(row), row);
+    }
 
-    int month = record.date.GetMonth();
+    // Files are in time order, so this is normally sorted already
+    if (!std::is_sorted(indexes.begin(), indexes.end()))
+    {
+        std::sort(indexes.begin(), indexes.end());
+    }
+    weatherDataBST.insertSorted(indexes.begin(), indexes.end());
+}
+
+// Add a row to its (year, month) partition, extending the last run when the
+// row directly follows it
+void WeatherDataCollection::indexPartition(std::uint32_t row)
+{
+    const DateTime& timestamp = columns.timestampAt(row);
+    Date date = timestamp.GetDate();
+    Partition& partition = partitions.findOrInsert(SegmentStore::partitionKey(date.GetYear(), date.GetMonth()));
+
+    if (!partition.runs.empty() && partition.runs.back().last == row)
+    {
+        partition.runs.back().last = row + 1;
+    }
+    else
+    {
+        partition.runs.push_back(RowRun{row, row + 1});
+    }
 
-    // Use custom Map's insert method
-    if (!dataByMonth.contains(month))
+    if (partition.rowCount > 0 && timestamp < partition.latest)
     {
-        dataByMonth.insert(month, std::vector<WeatherRecord*>());
+        partition.inTimeOrder = false;
     }
+    else
+    {
+        partition.latest = timestamp;
+    }
+    partition.rowCount++;
+    partition.aggregate.add(columns.windSpeedData()[row], columns.temperatureData()[row],
+                            columns.solarRadiationData()[row]);
+}
+
+// Number of loader threads; 0 means one per hardware thread
+void WeatherDataCollection::setLoadThreadCount(unsigned threads) {
+    loadThreadCount = threads;
+}
 
-    // Store the heap-allocated copy
-    dataByMonth.at(month).push_back(recordCopy);
+unsigned WeatherDataCollection::getLoadThreadCount() const {
+    return loadThreadCount;
 }
 
-// To check if month exists
-bool WeatherDataCollection::monthExists(int month) const {
-    return dataByMonth.contains(month);
+// Parse every file on up to threadCount workers. Workers pull the next
+// file index from a shared counter and write only to their own batch.
+// Whole lines only: the end offsets feed follow mode, which must not skip
+// a row that was still being written.
+void parseFilesConcurrently(const std::vector<std::string>& filenames, std::vector<RecordBatch>& batches,
+                            unsigned threadCount, const std::vector<std::string>& extraColumns) {
+    batches.clear();
+    batches.resize(filenames.size());
+    for (RecordBatch& batch : batches) {
+        batch.extraColumns = extraColumns;
+    }
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::min<unsigned>(threadCount, static_cast<unsigned>(filenames.size()));
+
+    std::atomic<std::size_t> nextFile(0);
+    auto worker = [&]() {
+        for (std::size_t i = nextFile++; i < filenames.size(); i = nextFile++) {
+            MetDataParser::parseFile(filenames[i], batches[i], 0, true);
+        }
+    };
+
+    if (threadCount <= 1) {
+        worker();
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threadCount; t++) {
+        workers.emplace_back(worker);
+    }
+    for (std::thread& t : workers) {
+        t.join();
+    }
 }
 
 // To allow the app to load from a txt file
 void WeatherDataCollection::loadFromFiles(const std::string& dataSourceFile) {
-    std::ifstream sourceFile(dataSourceFile);
-    if (!sourceFile.is_open()) {
+    std::vector<std::string> filenames;
+    if (!MetDataParser::readSourceList(dataSourceFile, filenames)) {
         std::cerr << "Error: Could not open data source file: " << dataSourceFile << std::endl;
         return;
     }
 
-    std::string filename;
     int fileProcessed = 0;
+    long long rowsProcessed = 0;
+    std::size_t bytesProcessed = 0;
 
     std::cout << "Reading files from: " << dataSourceFile << std::endl;
 
-    while (std::getline(sourceFile, filename)) {
-        if (filename.empty() || filename[0] == '#')
-            continue;
+    if (segments.isOpen()) {
+        loadIntoSegments(dataSourceFile, filenames);
+        return;
+    }
 
-        // Remove any extra whitespace
-        filename.erase(0, filename.find_first_not_of(" \t"));
-        filename.erase(filename.find_last_not_of(" \t") + 1);
+    auto startTime = std::chrono::steady_clock::now();
 
-        if (filename.empty()) continue;
+    // A snapshot is only valid for the exact files listed, so fingerprint them first
+    std::vector<FileFingerprint> fingerprints;
+    bool canSnapshot = snapshotEnabled && Snapshot::fingerprintFiles(filenames, fingerprints);
+    std::string snapshotPath = dataSourceFile + ".snapshot";
 
-        std::cout << "Processing file: " << filename << std::endl;
+    if (canSnapshot) {
+        Snapshot snapshot;
+        if (snapshot.open(snapshotPath, fingerprints, extraColumns) && loadFromSnapshot(snapshot)) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+            std::cout << "Loaded " << snapshot.getRecordCount() << " records from snapshot "
+                      << snapshotPath << " in " << elapsed.count() * 1000.0 << " ms" << std::endl;
 
-        std::ifstream dataFile(filename);
-        if (!dataFile.is_open())
+            // The snapshot covers each file exactly as fingerprinted
+            followedSourceFile = dataSourceFile;
+            for (const FileFingerprint& fingerprint : fingerprints) {
+                followedOffsets.insert(fingerprint.path, static_cast<std::size_t>(fingerprint.size));
+            }
+            return;
+        }
+    }
+
+    // Only a load into an empty collection describes exactly these files
+    bool writeSnapshot = canSnapshot && weatherDataBST.isEmpty();
+
+    std::vector<RecordBatch> batches;
+    parseFilesConcurrently(filenames, batches, loadThreadCount, extraColumns);
+
+    // A snapshot load counts each file as read to its end, so a file whose
+    // last line is still being written cannot be snapshotted yet
+    for (std::size_t i = 0; i < batches.size() && writeSnapshot; i++) {
+        writeSnapshot = batches[i].endOffset == fingerprints[i].size;
+    }
+
+    // Merge in source-list order so the result does not depend on thread timing
+    for (const RecordBatch& batch : batches) {
+        std::cout << "Processing file: " << batch.filename << std::endl;
+
+        if (!batch.opened)
         {
-            std::cerr << "Error: Could not open data file: " << filename << std::endl;
+            std::cerr << "Error: Could not open data file: " << batch.filename << std::endl;
             continue;
         }
 
-        std::string line;
-        bool firstLine = true;
-        int recordsProcessed = 0;
+        for (const std::string& message : batch.messages) {
+            std::cerr << message << std::endl;
+        }
+        storeRecords(batch);
+        rowsProcessed += batch.rows;
+        bytesProcessed += batch.bytes;
+        fileProcessed++;
+    }
+    followedSourceFile = dataSourceFile;
 
-        while (std::getline(dataFile, line)) {
-            if (line.empty()) continue;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    reportThroughput(std::cout, fileProcessed, rowsProcessed, bytesProcessed, elapsed.count());
 
-            if (firstLine)
-            {
-                if (line.find("WAST") != std::string::npos || line.find("Date") != std::string::npos)
-                {
-                    firstLine = false;
-                }
-                continue;
-            }
-            parseAndAddRecord(line);
-            recordsProcessed++;
-        }
+    if (writeSnapshot && !Snapshot::write(snapshotPath, fingerprints, columns, extraColumns, encodePartitions())) {
+        std::cerr << "Warning: Could not write snapshot " << snapshotPath << std::endl;
+    }
+}
 
-        dataFile.close();
+// Follow mode: parse only what was appended to the loaded files since the
+// last load or refresh. Files newly added to the source list are read in full.
+long long WeatherDataCollection::refreshFromFiles() {
+    if (followedSourceFile.empty()) {
+        std::cerr << "Error: No data has been loaded yet" << std::endl;
+        return 0;
+    }
 
-        fileProcessed++;
+    std::vector<std::string> filenames;
+    if (!MetDataParser::readSourceList(followedSourceFile, filenames)) {
+        std::cerr << "Error: Could not open data source file: " << followedSourceFile << std::endl;
+        return 0;
     }
 
-    sourceFile.close();
+    long long recordsAdded = 0;
+    for (const std::string& filename : filenames) {
+        const std::size_t* followed = followedOffsets.find(filename);
+        std::size_t offset = (followed != nullptr) ? *followed : 0;
+
+        RecordBatch batch;
+        batch.extraColumns = extraColumns;
+        MetDataParser::parseFile(filename, batch, offset, true);
+
+        if (!batch.opened)
+        {
+            std::cerr << "Error: Could not open data file: " << filename << std::endl;
+            continue;
+        }
+        for (const std::string& message : batch.messages) {
+            std::cerr << message << std::endl;
+        }
+        storeRecords(batch);
+
+        if (!batch.records.empty()) {
+            std::cout << "Added " << batch.records.size() << " new record(s) from " << filename << std::endl;
+        }
+        recordsAdded += static_cast<long long>(batch.records.size());
+    }
+    return recordsAdded;
 }
 
-// Parse and add record
-void WeatherDataCollection::parseAndAddRecord(const std::string& line) {
-    // Skip lines that are just commas or whitespace
-    if (line.find_first_not_of(" ,\t\r\n") == std::string::npos) {
-        return;
+// Hand a file's parsed records to the in-memory indexes or the segment store,
+// and remember how far into the file we have read. False if the store could
+// not take them.
+bool WeatherDataCollection::storeRecords(const RecordBatch& batch) {
+    if (segments.isOpen()) {
+        if (!segments.append(batch.records, batch.extraValues, batch.filename, batch.endOffset)) {
+            std::cerr << "Error: Could not store the rows of " << batch.filename << " in " << segments.getDirectory()
+                      << "; they will be read again next time" << std::endl;
+            return false;
+        }
+        for (const WeatherRecord& record : batch.records) {
+            Date date = record.timestamp.GetDate();
+            CachedAggregate* cached = segmentAggregates.find(SegmentStore::partitionKey(date.GetYear(), date.GetMonth()));
+            if (cached != nullptr) cached->valid = false;
+        }
+    } else {
+        addWeatherRecords(batch.records, batch.extraValues);
     }
+    followedOffsets.insert(batch.filename, batch.endOffset);
+    return true;
+}
 
-    std::stringstream ss(line);
-    std::string token;
-    std::vector<std::string> tokens;
+// Out-of-core load: each file is read in batches of about SEGMENT_LOAD_BYTES,
+// and each batch is stored before the next is parsed, so memory use does not
+// grow with the file. Reading starts where the store's last load of the file
+// stopped, so loading into an existing store only adds new rows.
+void WeatherDataCollection::loadIntoSegments(const std::string& dataSourceFile,
+                                             const std::vector<std::string>& filenames) {
+    auto startTime = std::chrono::steady_clock::now();
+    int fileProcessed = 0;
+    long long rowsProcessed = 0;
+    std::size_t bytesProcessed = 0;
+
+    for (const std::string& filename : filenames) {
+        std::cout << "Processing file: " << filename << std::endl;
 
-    try {
-        while (std::getline(ss, token, ',')) {
-            tokens.push_back(token);
+        const std::size_t* ingested = segments.findIngestedOffset(filename);
+        std::size_t offset = (ingested != nullptr) ? *ingested : 0;
+        bool opened = true;
+        for (;;) {
+            RecordBatch batch;
+            batch.extraColumns = extraColumns;
+            MetDataParser::parseFile(filename, batch, offset, true, SEGMENT_LOAD_BYTES);
+            if (!batch.opened) {
+                opened = false;
+                break;
+            }
+            for (const std::string& message : batch.messages) {
+                std::cerr << message << std::endl;
+            }
+
+            // A later batch must not be stored past rows that failed to store
+            if (batch.bytes == 0 || !storeRecords(batch)) break;
+            rowsProcessed += batch.rows;
+            bytesProcessed += batch.bytes;
+            offset = batch.endOffset;
+
+            // No data lines: the end of the file, or a header its rows cannot be read with
+            if (batch.rows == 0) break;
         }
 
-        // Check if we have enough columns
-        if (tokens.size() < 18) {
-            std::cerr << "Warning: Skipping line with insufficient columns: " << line << std::endl;
-            return;
+        if (!opened) {
+            std::cerr << "Error: Could not open data file: " << filename << std::endl;
+            continue;
         }
+        followedOffsets.insert(filename, offset);
+        fileProcessed++;
+    }
+    followedSourceFile = dataSourceFile;
 
-        // Parse date
-        Date date = parseDate(tokens[0]);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    reportThroughput(std::cout, fileProcessed, rowsProcessed, bytesProcessed, elapsed.count());
+    std::cout << segments.getTotalRows() << " records in segment store " << segments.getDirectory() << std::endl;
+}
 
-        // Parse numerical values - CORRECT COLUMN INDICES:
-        // Based on your CSV: WAST,DP,Dta,Dts,EV,QFE,QFF,QNH,RF,RH,S,SR,T,ST1,ST2,ST3,ST4,Sx
-        // Columns: 0=Date, 8=S (wind speed), 11=SR (solar radiation), 12=T (temperature)
-        double windSpeed = std::stod(tokens[10]);      // Column 11: S (wind speed)
-        double solarRadiation = std::stod(tokens[11]); // Column 12: SR (solar radiation)
-        double temperature = std::stod(tokens[17]);    // Column 18: T (temperature)
+bool WeatherDataCollection::openSegmentStore(const std::string& directory, std::size_t memoryBudget) {
+    if (!segments.open(directory, memoryBudget, extraColumns)) {
+        std::cerr << "Error: Could not open segment store " << directory << std::endl;
+        return false;
+    }
+    segmentAggregates = Map<int, CachedAggregate, TreeBackend<int, CachedAggregate>>();
+    return true;
+}
 
-        WeatherRecord record(date, windSpeed, temperature, solarRadiation);
-        addWeatherRecord(record);
+bool WeatherDataCollection::isOutOfCore() const {
+    return segments.isOpen();
+}
 
-        // Debug
-        std::cout << "Parsed record: " << date << " WS: " << windSpeed << " Temp: " << temperature << " Solar: " << solarRadiation << std::endl;
+const SegmentStore& WeatherDataCollection::getSegmentStore() const {
+    return segments;
+}
 
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing line: " << line << " - " << e.what() << std::endl;
+// Load the rows of a validated snapshot a column at a time and take its
+// partitions as stored; no text is parsed and no aggregate is recomputed.
+// Only the timestamp tree is rebuilt.
+bool WeatherDataCollection::loadFromSnapshot(const Snapshot& snapshot) {
+    // Snapshot row r becomes collection row base + r
+    std::uint32_t base = static_cast<std::uint32_t>(columns.size());
+    columns.append(snapshot.records());
+
+    // The stored partitions describe rows from 0, so they only fit an empty collection
+    if (base > 0 || !decodePartitions(snapshot.partitionData(), snapshot.partitionBytes())) {
+        for (std::uint32_t row = base; row < columns.size(); row++) {
+            indexPartition(row);
+        }
     }
+
+    bulkIndexDates(base);
+    return true;
 }
 
-Date WeatherDataCollection::parseDate(const std::string& dateTimeString) {
-    size_t spacePos = dateTimeString.find(' ');
-    if (spacePos == std::string::npos) {
-        throw std::invalid_argument("Invalid date format");
+// Per partition: key, row count, latest timestamp (minutes), time order flag,
+// run count and runs, then the aggregate. Written after the rows in a snapshot.
+std::string WeatherDataCollection::encodePartitions() const {
+    std::string blob;
+    appendBytes(blob, static_cast<std::uint64_t>(partitions.size()));
+    for (const auto& entry : partitions) {
+        const Partition& partition = entry.second;
+        appendBytes(blob, static_cast<std::int32_t>(entry.first));
+        appendBytes(blob, partition.rowCount);
+        appendBytes(blob, partition.latest.GetMinutesSinceEpoch());
+        appendBytes(blob, static_cast<std::uint32_t>(partition.inTimeOrder));
+        appendBytes(blob, static_cast<std::uint64_t>(partition.runs.size()));
+        blob.append(reinterpret_cast<const char*>(partition.runs.data()), partition.runs.size() * sizeof(RowRun));
+        partition.aggregate.write(blob);
     }
+    return blob;
+}
+
+// Replace the partitions with those encoded in data. Every run must lie
+// within the stored rows and add up to its partition's row count; otherwise
+// the partitions are left as they were and false is returned.
+bool WeatherDataCollection::decodePartitions(const char* data, std::size_t size) {
+    const char* pos = data;
+    const char* end = data + size;
+    std::uint64_t count = 0;
+    if (data == nullptr || !readBytes(pos, end, count)) return false;
+
+    Map<int, Partition, FlatBackend<int, Partition>> decoded;
+    for (std::uint64_t i = 0; i < count; i++) {
+        std::int32_t key = 0;
+        std::int64_t latest = 0;
+        std::uint32_t inTimeOrder = 0;
+        std::uint64_t runCount = 0;
+        Partition partition;
+        if (!readBytes(pos, end, key) || !readBytes(pos, end, partition.rowCount) || !readBytes(pos, end, latest) ||
+            !readBytes(pos, end, inTimeOrder) || !readBytes(pos, end, runCount) ||
+            runCount > static_cast<std::uint64_t>(end - pos) / sizeof(RowRun) || decoded.find(key) != nullptr) {
+            return false;
+        }
 
-    std::string datePart = dateTimeString.substr(0, spacePos);
-    std::stringstream ss(datePart);
+        partition.runs.resize(static_cast<std::size_t>(runCount));
+        std::memcpy(partition.runs.data(), pos, partition.runs.size() * sizeof(RowRun));
+        pos += partition.runs.size() * sizeof(RowRun);
 
-    int day, month, year;
-    char slash1, slash2;
+        std::uint64_t rows = 0;
+        for (const RowRun& run : partition.runs) {
+            if (run.first >= run.last || run.last > columns.size()) return false;
+            rows += run.last - run.first;
+        }
+        if (rows != partition.rowCount || !partition.aggregate.read(pos, end)) return false;
 
-    if (!(ss >> day >> slash1 >> month >> slash2 >> year)) {
-        throw std::invalid_argument("Failed to parse date");
+        partition.latest = DateTime::fromMinutes(latest);
+        partition.inTimeOrder = inTimeOrder != 0;
+        decoded.findOrInsert(key) = std::move(partition);
     }
+    if (pos != end) return false;
+
+    partitions = std::move(decoded);
+    return true;
+}
 
-    // Validate date components
-    if (day < 1 || day > 31 || month < 1 || month > 12 || year < 1900 || year > 2100) {
-        throw std::invalid_argument("Invalid date values: " + datePart);
+// Snapshots are written after a CSV load and reused while the files are unchanged
+void WeatherDataCollection::setSnapshotEnabled(bool enabled) {
+    snapshotEnabled = enabled;
+}
+
+bool WeatherDataCollection::isSnapshotEnabled() const {
+    return snapshotEnabled;
+}
+
+bool WeatherDataCollection::setExtraColumns(const std::vector<std::string>& names) {
+    if (columns.size() > 0 || segments.isOpen()) {
+        std::cerr << "Error: Extra columns must be chosen before any data is loaded" << std::endl;
+        return false;
     }
+    const char* const recordColumns[] = {MetDataParser::DATE_HEADER, "Date", MetDataParser::WIND_SPEED_HEADER,
+                                         MetDataParser::TEMPERATURE_HEADER, MetDataParser::SOLAR_RADIATION_HEADER};
+    for (std::size_t i = 0; i < names.size(); i++) {
+        bool repeated = std::find(names.begin(), names.begin() + i, names[i]) != names.begin() + i;
+        bool recordColumn = std::find(std::begin(recordColumns), std::end(recordColumns), names[i]) !=
+                            std::end(recordColumns);
+        if (names[i].empty() || repeated || recordColumn) {
+            std::cerr << "Error: '" << names[i] << "' cannot be an extra column" << std::endl;
+            return false;
+        }
+    }
+    extraColumns = names;
+    columns.setExtraCount(names.size());
+    return true;
+}
+
+const std::vector<std::string>& WeatherDataCollection::getExtraColumns() const {
+    return extraColumns;
+}
 
-    return Date(day, month, year);
+// Print the load throughput in MB/s and rows/s
+void reportThroughput(std::ostream& os, int files, long long rows, std::size_t bytes, double seconds) {
+    double megabytes = bytes / (1024.0 * 1024.0);
+    os << "Loaded " << rows << " rows from " << files << " file(s), "
+       << megabytes << " MB in " << seconds * 1000.0 << " ms";
+    if (seconds > 0.0) {
+        os << " (" << megabytes / seconds << " MB/s, " << rows / seconds << " rows/s)";
+    }
+    os << std::endl;
 }
 
 std::vector<WeatherRecord> WeatherDataCollection::getDataForMonth(int month) const {
     std::vector<WeatherRecord> result;
+    result.reserve(countRows(0, month));
 
-    if (monthExists(month))
-        {
-        // Use at() to access the vector
-        const auto& records = dataByMonth.at(month);
-        for (const auto& recordPtr : records)
-        {
-            result.push_back(*recordPtr);
+    // The month's partitions, year by year
+    getViewForMonth(month).forEachSlice([&result](const RecordSlice& slice) {
+        for (std::size_t row = 0; row < slice.size; row++) {
+            result.push_back(slice.recordAt(row));
         }
-    }
-
+    });
     return result;
 }
 
@@ -206,41 +827,254 @@ void printWeatherRecord(const WeatherRecord& record) {
     std::cout << record << std::endl;
 }
 
-struct CollectionContext {
-    std::vector<WeatherRecord>* records;
-    int targetMonth;
-};
+// Calculation of SPCC
+double WeatherDataCollection::calculateSPCC(int month, const std::string& correlationType) const {
+    // Pick the two columns once instead of comparing the type for every record
+    MeasuredField xField, yField;
+    if (correlationType == "S_T") {
+        xField = MeasuredField::WindSpeed;
+        yField = MeasuredField::Temperature;
+    } else if (correlationType == "S_R") {
+        xField = MeasuredField::WindSpeed;
+        yField = MeasuredField::SolarRadiation;
+    } else if (correlationType == "T_R") {
+        xField = MeasuredField::Temperature;
+        yField = MeasuredField::SolarRadiation;
+    } else {
+        return 0.0;
+    }
+
+    // Merge the month's partition aggregates: O(number of years), no rows read
+    Statistics::CoMoments merged;
+    forEachPartitionKey([&](int key) {
+        if (SegmentStore::monthOfKey(key) != month) return;
+        const PartitionAggregate* aggregate = findAggregate(key);
+        if (aggregate != nullptr) merged.merge(aggregate->coMoments(xField, yField));
+    });
+    return merged.correlation();
+}
+
+Statistics::CoMomentMatrix WeatherDataCollection::getCorrelationMatrix(const std::vector<std::string>& columnNames,
+                                                                      int month) const {
+    if (month < 1 || month > 12) return Statistics::CoMomentMatrix(columnNames.size());
+    return correlateColumns(columnNames, month, DateTime(), DateTime());
+}
+
+Statistics::CoMomentMatrix WeatherDataCollection::getCorrelationMatrix(const std::vector<std::string>& columnNames,
+                                                                      const DateTime& from, const DateTime& to) const {
+    return correlateColumns(columnNames, 0, from, to);
+}
+
+// One month of every year (month 1-12), or [from, to) when month is 0
+Statistics::CoMomentMatrix WeatherDataCollection::correlateColumns(const std::vector<std::string>& columnNames,
+                                                                   int month, const DateTime& from,
+                                                                   const DateTime& to) const {
+    std::size_t k = columnNames.size();
+    Statistics::CoMomentMatrix result(k);
+    auto selected = [&](const DateTime& timestamp) {
+        return (month != 0) ? timestamp.GetMonth() == month : (timestamp >= from && timestamp < to);
+    };
+
+    // Each column is a field of the records or one of the extra columns
+    const std::size_t NOT_EXTRA = extraColumns.size();
+    std::vector<MeasuredField> fields(k, MeasuredField::WindSpeed);
+    std::vector<std::size_t> extraOf(k, NOT_EXTRA);
+    bool fieldsOnly = true;
+    for (std::size_t c = 0; c < k; c++) {
+        const std::string& column = columnNames[c];
+        if (column == MetDataParser::WIND_SPEED_HEADER) fields[c] = MeasuredField::WindSpeed;
+        else if (column == MetDataParser::TEMPERATURE_HEADER) fields[c] = MeasuredField::Temperature;
+        else if (column == MetDataParser::SOLAR_RADIATION_HEADER) fields[c] = MeasuredField::SolarRadiation;
+        else {
+            std::size_t extra = std::find(extraColumns.begin(), extraColumns.end(), column) - extraColumns.begin();
+            if (extra == NOT_EXTRA) {
+                throw std::invalid_argument("Column '" + column + "' is not stored; see setExtraColumns");
+            }
+            extraOf[c] = extra;
+            fieldsOnly = false;
+        }
+    }
 
-void collectByMonth(const WeatherRecord& record, void* context) {
-    CollectionContext* ctx = static_cast<CollectionContext*>(context);
-    if (record.date.GetMonth() == ctx->targetMonth) {
-        ctx->records->push_back(record);
+    if (fieldsOnly && month != 0) {
+        // Stored fields over a month: merge the partition aggregates, no rows read
+        forEachPartitionKey([&](int key) {
+            if (SegmentStore::monthOfKey(key) != month) return;
+            const PartitionAggregate* aggregate = findAggregate(key);
+            if (aggregate != nullptr) result.merge(aggregate->coMomentMatrix(fields));
+        });
+        return result;
     }
+
+    RowBlock block(result);
+    std::vector<double> row(k);
+    std::vector<const double*> fieldValues(k);
+    auto addSlice = [&](const RecordSlice& slice) {
+        for (std::size_t c = 0; c < k; c++) fieldValues[c] = slice.column(fields[c]).data();
+        for (std::size_t r = 0; r < slice.size; r++) {
+            if (!selected(slice.timestamps[r])) continue;
+            for (std::size_t c = 0; c < k; c++) {
+                row[c] = (extraOf[c] == NOT_EXTRA) ? fieldValues[c][r] : slice.extraAt(r, extraOf[c]);
+            }
+            block.add(row.data());
+        }
+    };
+
+    if (month != 0) {
+        getViewForMonth(month).forEachSlice(addSlice);
+    } else {
+        // A range: the rows of the partitions it overlaps
+        Date first = from.GetDate();
+        Date last = to.GetDate();
+        int firstKey = SegmentStore::partitionKey(first.GetYear(), first.GetMonth());
+        int lastKey = SegmentStore::partitionKey(last.GetYear(), last.GetMonth());
+
+        forEachPartitionKey([&](int key) {
+            if (key < firstKey || key > lastKey) return;
+            getViewForYearMonth(SegmentStore::yearOfKey(key), SegmentStore::monthOfKey(key)).forEachSlice(addSlice);
+        });
+    }
+    block.flush();
+    return result;
 }
 
-// Calculation of SPCC
-double WeatherDataCollection::calculateSPCC(int month, const std::string& correlationType) const {
-    auto monthlyData = getDataForMonth(month);
-    if (monthlyData.empty()) {
-        return 0.0;
+// The aggregate of one partition: kept up to date in memory; built by one
+// scan of the segment, then cached until the segment changes, out of core
+const PartitionAggregate* WeatherDataCollection::findAggregate(int key) const {
+    if (!segments.isOpen()) {
+        const Partition* partition = partitions.find(key);
+        return (partition != nullptr && partition->rowCount > 0) ? &partition->aggregate : nullptr;
     }
 
-    std::vector<double> x, y;
+    if (segments.getRowCount(key) == 0) {
+        return nullptr;
+    }
+    CachedAggregate& cached = segmentAggregates.findOrInsert(key);
+    if (!cached.valid) {
+        cached.aggregate = PartitionAggregate();
+        getViewForYearMonth(SegmentStore::yearOfKey(key), SegmentStore::monthOfKey(key))
+            .forEachSlice([&cached](const RecordSlice& slice) { cached.aggregate.add(slice); });
+        cached.valid = true;
+        aggregateScans++;
+    }
+    return &cached.aggregate;
+}
+
+// The aggregate with its mean absolute deviations filled in, by one scan of
+// the partition if they are not already known
+const PartitionAggregate& WeatherDataCollection::withMAD(int key, const PartitionAggregate& aggregate) const {
+    if (!aggregate.madValid) {
+        RecordView rows = getViewForYearMonth(SegmentStore::yearOfKey(key), SegmentStore::monthOfKey(key));
+        aggregate.windSpeedMAD = Statistics::calculateMAD(rows.column(MeasuredField::WindSpeed), aggregate.windSpeed.mean());
+        aggregate.temperatureMAD =
+            Statistics::calculateMAD(rows.column(MeasuredField::Temperature), aggregate.temperature.mean());
+        aggregate.madValid = true;
+        aggregateScans++;
+    }
+    return aggregate;
+}
+
+// A copy of the partition's aggregate with its MADs, like withMAD but
+// touching no shared state: reads cached aggregates without filling the
+// cache, and counts the scans it needs in scans.
+PartitionAggregate WeatherDataCollection::computeAggregate(int key, std::size_t& scans) const {
+    RecordView rows = getViewForYearMonth(SegmentStore::yearOfKey(key), SegmentStore::monthOfKey(key));
+    PartitionAggregate aggregate;
+
+    const Partition* partition = segments.isOpen() ? nullptr : partitions.find(key);
+    const CachedAggregate* cached = segments.isOpen() ? segmentAggregates.find(key) : nullptr;
+    if (partition != nullptr) {
+        aggregate = partition->aggregate;
+    } else if (cached != nullptr && cached->valid) {
+        aggregate = cached->aggregate;
+    } else {
+        rows.forEachSlice([&aggregate](const RecordSlice& slice) { aggregate.add(slice); });
+        scans++;
+    }
+
+    if (!aggregate.madValid) {
+        aggregate.windSpeedMAD = Statistics::calculateMAD(rows.column(MeasuredField::WindSpeed), aggregate.windSpeed.mean());
+        aggregate.temperatureMAD =
+            Statistics::calculateMAD(rows.column(MeasuredField::Temperature), aggregate.temperature.mean());
+        aggregate.madValid = true;
+        scans++;
+    }
+    return aggregate;
+}
+
+Statistics::QuantileSketch WeatherDataCollection::getQuantileSketch(MeasuredField field, int year, int month) const {
+    if (month < 1 || month > 12) return Statistics::QuantileSketch();
+    if (year != 0) return getQuantileSketch(field, year, month, year, month);
+
+    Statistics::QuantileSketch merged;
+    forEachPartitionKey([&](int key) {
+        if (SegmentStore::monthOfKey(key) != month) return;
+        const PartitionAggregate* aggregate = findAggregate(key);
+        if (aggregate != nullptr) merged.merge(aggregate->quantiles(field));
+    });
+    return merged;
+}
+
+Statistics::QuantileSketch WeatherDataCollection::getQuantileSketch(MeasuredField field, int fromYear, int fromMonth,
+                                                                    int toYear, int toMonth) const {
+    int firstKey = SegmentStore::partitionKey(fromYear, fromMonth);
+    int lastKey = SegmentStore::partitionKey(toYear, toMonth);
 
-    for (const auto& record : monthlyData) {
-        if (correlationType == "S_T") {
-            x.push_back(record.windSpeed);
-            y.push_back(record.temperature);
-        } else if (correlationType == "S_R") {
-            x.push_back(record.windSpeed);
-            y.push_back(record.solarRadiation);
-        } else if (correlationType == "T_R") {
-            x.push_back(record.temperature);
-            y.push_back(record.solarRadiation);
+    Statistics::QuantileSketch merged;
+    forEachPartitionKey([&](int key) {
+        if (key < firstKey || key > lastKey) return;
+        const PartitionAggregate* aggregate = findAggregate(key);
+        if (aggregate != nullptr) merged.merge(aggregate->quantiles(field));
+    });
+    return merged;
+}
+
+std::size_t WeatherDataCollection::getAggregateScanCount() const {
+    return aggregateScans;
+}
+
+double WeatherDataCollection::getMonthlyPercentile(int month, MeasuredField field, double fraction) const {
+    return getQuantileSketch(field, 0, month).quantile(std::min(1.0, std::max(0.0, fraction)));
+}
+
+double WeatherDataCollection::getMonthlyMedian(int month, MeasuredField field) const {
+    return getMonthlyPercentile(month, field, 0.5);
+}
+
+// Rows of one month of one year, in time order. Read straight from the
+// partition's runs: O(k), touching only that month's rows. A partition loaded
+// out of time order is read with a range scan of the tree instead, O(log n + k).
+std::vector<std::uint32_t> WeatherDataCollection::rowsForYearMonth(int year, int month) const
+{
+    std::vector<std::uint32_t> result;
+
+    const Partition* partition = (month >= 1 && month <= 12) ? partitions.find(SegmentStore::partitionKey(year, month)) : nullptr;
+    if (partition == nullptr)
+    {
+        return result;
+    }
+
+    result.reserve(partition->rowCount);
+    if (partition->inTimeOrder)
+    {
+        for (const RowRun& run : partition->runs)
+        {
+            for (std::uint32_t row = run.first; row < run.last; row++)
+            {
+                result.push_back(row);
+            }
         }
+        return result;
     }
 
-    return Statistics::calculateSPCC(x, y);
+    DateTime from(Date(1, month, year));
+    DateTime to((month == 12) ? Date(1, 1, year + 1) : Date(1, month + 1, year));
+
+    weatherDataBST.visitRange(from, to, [&result](const RecordIndex& index)
+    {
+        result.push_back(index.row);
+    });
+
+    return result;
 }
 
 // New implementation for Lab 11 / get the data for the month and year
@@ -248,64 +1082,152 @@ std::vector<WeatherRecord> WeatherDataCollection::getDataForYearMonth(int year,
 {
     std::vector<WeatherRecord> result;
 
-    if (monthExists(month))
+    if (segments.isOpen()) {
+        // A segment is stored in time order
+        getViewForYearMonth(year, month).forEachSlice([&result](const RecordSlice& slice) {
+            for (std::size_t row = 0; row < slice.size; row++) {
+                result.push_back(slice.recordAt(row));
+            }
+        });
+        return result;
+    }
+
+    for (std::uint32_t row : rowsForYearMonth(year, month))
     {
-        for (const auto& recordPtr : dataByMonth.at(month))
-        {
-            if (recordPtr && recordPtr->date.GetYear() == year)
-            {
-                result.push_back(*recordPtr);
+        result.push_back(columns.recordAt(row));
+    }
+
+    return result;
+}
+
+RecordView WeatherDataCollection::getViewForMonth(int month) const
+{
+    return RecordView(*this, 0, month);
+}
+
+RecordView WeatherDataCollection::getViewForYearMonth(int year, int month) const
+{
+    return RecordView(*this, year, month);
+}
+
+const WeatherColumns& WeatherDataCollection::getColumns() const
+{
+    return columns;
+}
+
+// Rows in a view, from the partition (or segment) row counts
+std::size_t WeatherDataCollection::countRows(int year, int month) const
+{
+    if (month < 1 || month > 12) return 0;
+
+    if (segments.isOpen())
+    {
+        return (year != 0) ? segments.getRowCount(SegmentStore::partitionKey(year, month))
+                           : segments.getMonthRowCount(month);
+    }
+
+    if (year != 0)
+    {
+        const Partition* partition = partitions.find(SegmentStore::partitionKey(year, month));
+        return (partition != nullptr) ? partition->rowCount : 0;
+    }
+
+    std::size_t count = 0;
+    for (const auto& entry : partitions)
+    {
+        if (SegmentStore::monthOfKey(entry.first) == month) count += entry.second.rowCount;
+    }
+    return count;
+}
+
+// Records timestamped in [from, to), in time order
+std::vector<WeatherRecord> WeatherDataCollection::getDataForRange(const DateTime& from, const DateTime& to) const
+{
+    std::vector<WeatherRecord> result;
+
+    if (segments.isOpen()) {
+        Date first = from.GetDate();
+        Date last = to.GetDate();
+        int firstKey = SegmentStore::partitionKey(first.GetYear(), first.GetMonth());
+        int lastKey = SegmentStore::partitionKey(last.GetYear(), last.GetMonth());
+
+        for (int key = firstKey; key <= lastKey; key++) {
+            std::shared_ptr<const Segment> segment = segments.acquire(key);
+            if (segment == nullptr) continue;
+            for (std::size_t block = 0; block < segment->blockCount(); block++) {
+                RecordSlice slice = segment->block(block);
+                for (std::size_t row = 0; row < slice.size; row++) {
+                    if (slice.timestamps[row] >= from && slice.timestamps[row] < to) {
+                        result.push_back(slice.recordAt(row));
+                    }
+                }
             }
         }
+        return result;
     }
 
+    weatherDataBST.visitRange(from, to, [&](const RecordIndex& index)
+    {
+        result.push_back(columns.recordAt(index.row));
+    });
+
     return result;
 }
 
 // Statistical namespace implementation
 namespace Statistics
 {
-    double calculateMean(const std::vector<double>& values)
+    // Each function reads the view one span at a time and reduces each span
+    // with the vectorised kernels in StatKernels (see there for how far the
+    // results may differ from a plain scalar loop)
+
+    double calculateMean(const ColumnView& values)
     {
         if (values.empty())
             return 0.0;
 
         double sum = 0.0;
-        for (double val : values)
+        values.forEachSpan([&sum](Span<double> span)
         {
-            sum += val;
-        }
+            sum += StatKernels::sum(span.data(), span.size());
+        });
         return sum / values.size();
     }
 
-    double calculateStdDev(const std::vector<double>& values)
+    double calculateStdDev(const ColumnView& values)
     {
-        if (values.size() < 2)
+        std::size_t count = values.size();
+        if (count < 2)
             return 0.0;
 
         double mean = calculateMean(values);
         double sumSq = 0.0;
 
-        for (double val : values)
+        values.forEachSpan([&](Span<double> span)
         {
-            sumSq += (val - mean) * (val - mean);
-        }
-        return std::sqrt(sumSq / (values.size() - 1));
+            sumSq += StatKernels::sumSquaredDeviations(span.data(), span.size(), mean);
+        });
+        return std::sqrt(sumSq / (count - 1));
     }
 
-    double calculateMAD(const std::vector<double>& values)
+    double calculateMAD(const ColumnView& values)
     {
-        if (values.empty())
+        return values.empty() ? 0.0 : calculateMAD(values, calculateMean(values));
+    }
+
+    double calculateMAD(const ColumnView& values, double mean)
+    {
+        std::size_t count = values.size();
+        if (count == 0)
             return 0.0;
 
-        double mean = calculateMean(values);
         double sumAbs = 0.0;
 
-        for (double val : values)
+        values.forEachSpan([&](Span<double> span)
         {
-            sumAbs += std::abs(val - mean);
-        }
-        return sumAbs / values.size();
+            sumAbs += StatKernels::sumAbsDeviations(span.data(), span.size(), mean);
+        });
+        return sumAbs / count;
     }
 
     double calculateSPCC(const std::vector<double>& x, const std::vector<double>& y)
@@ -313,27 +1235,350 @@ namespace Statistics
         if (x.size() != y.size() || x.size() < 2)
             return 0.0;
 
-        int n = x.size();
-        double sum_x = 0.0, sum_y = 0.0;
-        double sum_xy = 0.0, sum_x2 = 0.0, sum_y2 = 0.0;
+        CoMoments sums;
+        sums.add(x.data(), y.data(), x.size());
+        return sums.correlation();
+    }
 
-        for (int i = 0; i < n; ++i) {
-           sum_x += x[i];
-           sum_y += y[i];
-           sum_xy += x[i] * y[i];
-           sum_x2 += x[i] * x[i];
-           sum_y2 += y[i] * y[i];
+    double RunningStats::stdDev() const
+    {
+        return (count < 2) ? 0.0 : std::sqrt(m2 / (count - 1));
     }
 
-    double numerator = n * sum_xy - sum_x * sum_y;
-    double denominator = std::sqrt((n * sum_x2 - sum_x * sum_x) * (n * sum_y2 - sum_y * sum_y));
+    void CoMoments::add(const double* x, const double* y, std::size_t n)
+    {
+        // Small enough that both columns of a block stay in L1 between its two reads
+        const std::size_t BLOCK = 512;
 
-    // Use epsilon for floating point comparison instead of ==
-    if (std::abs(denominator) < 1e-10)
-        return 0.0;
+        for (std::size_t first = 0; first < n; first += BLOCK)
+        {
+            std::size_t size = std::min(BLOCK, n - first);
+            CoMoments block;
+            block.count = size;
+            block.meanX = StatKernels::sum(x + first, size) / size;
+            block.meanY = StatKernels::sum(y + first, size) / size;
+
+            StatKernels::CenteredSums deviations =
+                StatKernels::centeredPairSums(x + first, y + first, size, block.meanX, block.meanY);
+            block.m2X = deviations.sumDX2;
+            block.m2Y = deviations.sumDY2;
+            block.cXY = deviations.sumDXDY;
+            merge(block);
+        }
+    }
+
+    void CoMoments::merge(const CoMoments& other)
+    {
+        if (other.count == 0)
+            return;
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+
+        double n = static_cast<double>(count) + other.count;
+        double dx = other.meanX - meanX;
+        double dy = other.meanY - meanY;
+        double weight = static_cast<double>(count) * other.count / n;
+
+        meanX += dx * other.count / n;
+        meanY += dy * other.count / n;
+        m2X += other.m2X + dx * dx * weight;
+        m2Y += other.m2Y + dy * dy * weight;
+        cXY += other.cXY + dx * dy * weight;
+        count += other.count;
+    }
+
+    CoMomentMatrix::CoMomentMatrix(std::size_t columns)
+        : columnCount(columns), count(0), means(columns, 0.0), comoments(columns * columns, 0.0) {}
+
+    void CoMomentMatrix::assign(std::size_t rows, const std::vector<double>& columnMeans,
+                                const std::vector<double>& matrix)
+    {
+        count = rows;
+        means = columnMeans;
+        comoments = matrix;
+    }
+
+    void CoMomentMatrix::addBlock(const double* const* columns, std::size_t n)
+    {
+        // Small enough that a block of every column stays in cache for the cross products
+        const std::size_t BLOCK = 512;
+        const std::size_t k = columnCount;
+        CoMomentMatrix block(k);
+
+        for (std::size_t first = 0; first < n; first += BLOCK)
+        {
+            std::size_t size = std::min(BLOCK, n - first);
+            block.count = size;
+            for (std::size_t i = 0; i < k; i++)
+            {
+                block.means[i] = StatKernels::sum(columns[i] + first, size) / size;
+            }
+            for (std::size_t i = 0; i < k; i++)
+            {
+                block.comoments[i * k + i] = StatKernels::sumSquaredDeviations(columns[i] + first, size, block.means[i]);
+                for (std::size_t j = i + 1; j < k; j++)
+                {
+                    double cross = StatKernels::centeredCrossSum(columns[i] + first, columns[j] + first, size,
+                                                                 block.means[i], block.means[j]);
+                    block.comoments[i * k + j] = cross;
+                    block.comoments[j * k + i] = cross;
+                }
+            }
+            merge(block);
+        }
+    }
+
+    // Same update as CoMoments::merge, for every pair of columns
+    void CoMomentMatrix::merge(const CoMomentMatrix& other)
+    {
+        if (other.count == 0)
+            return;
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+
+        const std::size_t k = columnCount;
+        double n = static_cast<double>(count) + other.count;
+        double weight = static_cast<double>(count) * other.count / n;
+
+        std::vector<double> delta(k);
+        for (std::size_t i = 0; i < k; i++)
+        {
+            delta[i] = other.means[i] - means[i];
+        }
+        for (std::size_t i = 0; i < k; i++)
+        {
+            for (std::size_t j = 0; j < k; j++)
+            {
+                comoments[i * k + j] += other.comoments[i * k + j] + delta[i] * delta[j] * weight;
+            }
+            means[i] += delta[i] * other.count / n;
+        }
+        count += other.count;
+    }
+
+    double CoMomentMatrix::correlation(std::size_t i, std::size_t j) const
+    {
+        if (count < 2)
+            return 0.0;
 
-    return numerator / denominator;
+        double denominator = std::sqrt(getCoMoment(i, i) * getCoMoment(j, j));
+
+        // Use epsilon for floating point comparison instead of ==
+        if (denominator < 1e-10)
+            return 0.0;
+
+        return getCoMoment(i, j) / denominator;
+    }
+
+    QuantileSketch::QuantileSketch(unsigned topCapacity)
+        : k(std::max(8u, topCapacity)), count(0), minimum(0.0), maximum(0.0), levels(), retained(0), totalCapacity(0),
+          coin(0x9E3779B97F4A7C15ULL) {}
+
+    // Capacity of a level: k at the top, shrinking by 2/3 per level below it,
+    // never under 2
+    std::size_t QuantileSketch::capacity(std::size_t level) const
+    {
+        std::size_t depth = levels.size() - level - 1;
+        double size = std::ceil(k * std::pow(2.0 / 3.0, static_cast<double>(depth)));
+        return std::max<std::size_t>(2, static_cast<std::size_t>(size));
+    }
+
+    // A new top level; every level below it shrinks
+    void QuantileSketch::addLevel()
+    {
+        levels.emplace_back();
+        totalCapacity = 0;
+        for (std::size_t h = 0; h < levels.size(); h++)
+            totalCapacity += capacity(h);
+    }
+
+    void QuantileSketch::add(double value)
+    {
+        if (count == 0)
+        {
+            minimum = maximum = value;
+            if (levels.empty())
+                addLevel();
+        }
+        else
+        {
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }
+        count++;
 
+        levels[0].push_back(value);
+        if (++retained >= totalCapacity)
+            compress();
+    }
+
+    void QuantileSketch::merge(const QuantileSketch& other)
+    {
+        if (other.count == 0)
+            return;
+        if (count == 0)
+        {
+            *this = other;
+            return;
+        }
+
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+        count += other.count;
+
+        while (levels.size() < other.levels.size())
+            addLevel();
+        for (std::size_t h = 0; h < other.levels.size(); h++)
+        {
+            std::vector<double>& level = levels[h];
+            std::size_t middle = level.size();
+            level.insert(level.end(), other.levels[h].begin(), other.levels[h].end());
+            if (h > 0)
+                std::inplace_merge(level.begin(), level.begin() + middle, level.end());
+        }
+        retained += other.retained;
+        while (retained >= totalCapacity)
+            compress();
+    }
+
+    // Runs when the sketch as a whole is full: compact the lowest level at or
+    // over its own capacity by moving every other value of it, in order, up a
+    // level at twice the weight. An odd value out stays behind, so the total
+    // weight is unchanged. Levels above 0 are kept sorted, so only level 0
+    // ever needs a sort; the rest take a merge of two sorted runs.
+    void QuantileSketch::compress()
+    {
+        std::size_t h = 0;
+        while (levels[h].size() < capacity(h))
+            h++;
+        if (h + 1 == levels.size())
+            addLevel();
+
+        std::vector<double>& level = levels[h];
+        if (h == 0)
+            std::sort(level.begin(), level.end());
+
+        coin ^= coin << 13;
+        coin ^= coin >> 7;
+        coin ^= coin << 17;
+        std::vector<double>& next = levels[h + 1];
+        std::size_t middle = next.size();
+        std::size_t paired = level.size() & ~std::size_t(1);
+        for (std::size_t i = coin & 1; i < paired; i += 2)
+        {
+            next.push_back(level[i]);
+        }
+        std::inplace_merge(next.begin(), next.begin() + middle, next.end());
+        level.erase(level.begin(), level.begin() + paired);
+        retained -= paired / 2;
+    }
+
+    // k, level count, count, minimum, maximum and coin, then each level's
+    // size and values; with the coin, a sketch read back goes on exactly as
+    // the one written would have
+    void QuantileSketch::write(std::string& blob) const
+    {
+        appendBytes(blob, static_cast<std::uint32_t>(k));
+        appendBytes(blob, static_cast<std::uint32_t>(levels.size()));
+        appendBytes(blob, count);
+        appendBytes(blob, minimum);
+        appendBytes(blob, maximum);
+        appendBytes(blob, coin);
+        for (const std::vector<double>& level : levels)
+        {
+            appendBytes(blob, static_cast<std::uint64_t>(level.size()));
+            blob.append(reinterpret_cast<const char*>(level.data()), level.size() * sizeof(double));
+        }
+    }
+
+    bool QuantileSketch::read(const char*& pos, const char* end)
+    {
+        std::uint32_t topCapacity = 0, levelCount = 0;
+        if (!readBytes(pos, end, topCapacity) || !readBytes(pos, end, levelCount) || topCapacity < 8 ||
+            levelCount > 64)
+            return false;
+
+        QuantileSketch loaded(topCapacity);
+        if (!readBytes(pos, end, loaded.count) || !readBytes(pos, end, loaded.minimum) ||
+            !readBytes(pos, end, loaded.maximum) || !readBytes(pos, end, loaded.coin) ||
+            (loaded.count > 0) != (levelCount > 0))
+            return false;
+
+        for (std::uint32_t h = 0; h < levelCount; h++)
+        {
+            std::uint64_t size = 0;
+            if (!readBytes(pos, end, size) || size > static_cast<std::uint64_t>(end - pos) / sizeof(double))
+                return false;
+            loaded.addLevel();
+            std::vector<double>& level = loaded.levels.back();
+            level.resize(static_cast<std::size_t>(size));
+            std::memcpy(level.data(), pos, level.size() * sizeof(double));
+            pos += level.size() * sizeof(double);
+            // compress and merge rely on every level but the first being sorted
+            if (h > 0 && !std::is_sorted(level.begin(), level.end()))
+                return false;
+            loaded.retained += level.size();
+        }
+
+        *this = std::move(loaded);
+        return true;
+    }
+
+    // Empirical 99% bound for a single quantile of a KLL sketch with
+    // parameter k (the fit published with the Apache DataSketches KLL sketch)
+    double QuantileSketch::getRankError() const
+    {
+        return 2.296 / std::pow(static_cast<double>(k), 0.9723);
+    }
+
+    double QuantileSketch::quantile(double fraction) const
+    {
+        if (count == 0)
+            return 0.0;
+        if (fraction <= 0.0)
+            return minimum;
+        if (fraction >= 1.0)
+            return maximum;
+
+        std::vector<std::pair<double, std::uint64_t>> weighted;
+        weighted.reserve(getRetainedCount());
+        for (std::size_t h = 0; h < levels.size(); h++)
+        {
+            for (double value : levels[h])
+                weighted.emplace_back(value, std::uint64_t(1) << h);
+        }
+        std::sort(weighted.begin(), weighted.end());
+
+        // First value whose cumulative weight passes the wanted rank
+        double rank = fraction * count;
+        std::uint64_t cumulative = 0;
+        for (const auto& entry : weighted)
+        {
+            cumulative += entry.second;
+            if (cumulative > rank)
+                return entry.first;
+        }
+        return maximum;
+    }
+
+    double CoMoments::correlation() const
+    {
+        if (count < 2)
+            return 0.0;
+
+        double denominator = std::sqrt(m2X * m2Y);
+
+        // Use epsilon for floating point comparison instead of ==
+        if (denominator < 1e-10)
+            return 0.0;
+
+        return cXY / denominator;
     }
 }
 
@@ -346,63 +1591,153 @@ void WeatherDataCollection::generateMonthlyStats(int year, const std::string& fi
         return;
     }
 
-    // Write the year header exactly as specified
-    file << year << std::endl;
-
-    std::string monthNames[] = {"January", "February", "March", "April", "May", "June",
-                               "July", "August", "September", "October", "November", "December"};
-
+    const PartitionAggregate* months[12];
     for (int month = 1; month <= 12; month++)
     {
-        auto monthlyData = getDataForYearMonth(year, month);
-
-        if (monthlyData.empty())
+        // Straight from the partition's aggregate; only the MADs may need a scan
+        int key = SegmentStore::partitionKey(year, month);
+        months[month - 1] = findAggregate(key);
+        if (months[month - 1] != nullptr)
         {
-            // Write empty data for months with no data
-            file << monthNames[month-1] << ",0.0(0.0, 0.0),0.0(0.0, 0.0),0.0" << std::endl;
-            continue;
+            withMAD(key, *months[month - 1]);
         }
+    }
+    writeMonthlyStats(file, year, months);
 
-        // Extract data for calculations
-        std::vector<double> windSpeeds, temperatures, solarRads;
-        double totalSolar = 0.0;
+    file.close();
+    std::cout << "Monthly statistics written to " << filename << std::endl;
+}
 
-        for (const auto& record : monthlyData)
-        {
-            windSpeeds.push_back(record.windSpeed);
-            temperatures.push_back(record.temperature);
-            solarRads.push_back(record.solarRadiation);
-            totalSolar += record.solarRadiation;
+// Aggregate every partition of the years first, on worker threads that each
+// take the next partition from a shared counter and fill only their own
+// slot, then write the files one after another from the results.
+std::size_t WeatherDataCollection::generateMonthlyStatsForYears(const std::vector<int>& years,
+                                                                const std::string& filenamePrefix,
+                                                                unsigned threadCount) const {
+    std::vector<int> reportYears = years.empty() ? getAvailableYears() : years;
+    std::sort(reportYears.begin(), reportYears.end());
+    reportYears.erase(std::unique(reportYears.begin(), reportYears.end()), reportYears.end());
+
+    std::vector<int> keys;
+    forEachPartitionKey([&](int key) {
+        if (std::binary_search(reportYears.begin(), reportYears.end(), SegmentStore::yearOfKey(key))) {
+            keys.push_back(key);
+        }
+    });
+
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::max(1u, std::min<unsigned>(threadCount, static_cast<unsigned>(keys.size())));
+
+    std::vector<PartitionAggregate> results(keys.size());
+    std::vector<std::size_t> scans(threadCount, 0);
+    std::atomic<std::size_t> nextKey(0);
+    auto worker = [&](unsigned id) {
+        for (std::size_t i = nextKey++; i < keys.size(); i = nextKey++) {
+            results[i] = computeAggregate(keys[i], scans[id]);
         }
+    };
+
+    if (threadCount <= 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threadCount; t++) {
+            workers.emplace_back(worker, t);
+        }
+        for (std::thread& t : workers) {
+            t.join();
+        }
+    }
 
-        // Calculate statistics using DECOUPLED functions
-        double avgWind = Statistics::calculateMean(windSpeeds);
-        double avgTemp = Statistics::calculateMean(temperatures);
-        double stdWind = Statistics::calculateStdDev(windSpeeds);
-        double stdTemp = Statistics::calculateStdDev(temperatures);
-        double madWind = Statistics::calculateMAD(windSpeeds);
-        double madTemp = Statistics::calculateMAD(temperatures);
+    for (std::size_t count : scans) {
+        aggregateScans += count;
+    }
 
-        // Write in EXACT format: Month,AvgWS(std,mad),AvgTemp(std,mad),TotalSolar
-        file << monthNames[month-1] << ","
-             << avgWind << "(" << stdWind << ", " << madWind << "),"
-             << avgTemp << "(" << stdTemp << ", " << madTemp << "),"
-             << totalSolar << std::endl;
+    // Keep what the pass worked out, so later queries need not scan again
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        if (segments.isOpen()) {
+            CachedAggregate& cached = segmentAggregates.findOrInsert(keys[i]);
+            cached.aggregate = results[i];
+            cached.valid = true;
+        } else if (const Partition* partition = partitions.find(keys[i])) {
+            partition->aggregate.windSpeedMAD = results[i].windSpeedMAD;
+            partition->aggregate.temperatureMAD = results[i].temperatureMAD;
+            partition->aggregate.madValid = true;
+        }
     }
 
-    file.close();
-    std::cout << "Monthly statistics written to " << filename << std::endl;
+    std::size_t written = 0;
+    std::size_t next = 0;
+    for (int year : reportYears) {
+        const PartitionAggregate* months[12] = {};
+        for (; next < keys.size() && SegmentStore::yearOfKey(keys[next]) == year; next++) {
+            months[SegmentStore::monthOfKey(keys[next]) - 1] = &results[next];
+        }
+
+        std::string filename = filenamePrefix + std::to_string(year) + ".csv";
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not create file " << filename << std::endl;
+            continue;
+        }
+        writeMonthlyStats(file, year, months);
+        written++;
+    }
+
+    std::cout << "Monthly statistics for " << written << " year(s) written to " << filenamePrefix << "<year>.csv"
+              << std::endl;
+    return written;
 }
 
 // Display all data
 void WeatherDataCollection::displayAllData() const {
     std::cout << "=== All Weather Data (" << getTotalRecords() << " records) ===" << std::endl;
-    weatherDataBST.inOrder([](const WeatherRecord& record)
+
+    if (segments.isOpen())
+    {
+        segments.forEachPartition([this](int key, std::size_t)
+        {
+            std::shared_ptr<const Segment> segment = segments.acquire(key);
+            if (segment == nullptr) return;
+            for (std::size_t block = 0; block < segment->blockCount(); block++)
+            {
+                RecordSlice slice = segment->block(block);
+                for (std::size_t row = 0; row < slice.size; row++)
+                {
+                    std::cout << slice.recordAt(row) << std::endl;
+                }
+            }
+        });
+        return;
+    }
+
+    for (const RecordIndex& index : weatherDataBST)
     {
-        std::cout << record << std::endl;
+        std::cout << columns.recordAt(index.row) << std::endl;
+    }
+}
+
+// Years that have at least one record, read from the partition keys
+std::vector<int> WeatherDataCollection::getAvailableYears() const {
+    if (segments.isOpen()) {
+        return segments.getYears();
+    }
+
+    std::vector<int> years;
+    forEachPartitionKey([&](int key) {
+        int year = SegmentStore::yearOfKey(key);
+        if (years.empty() || years.back() != year) {
+            years.push_back(year);
+        }
     });
+    return years;
 }
 
 int WeatherDataCollection::getTotalRecords() const {
+    if (segments.isOpen()) {
+        return static_cast<int>(segments.getTotalRows());
+    }
     return weatherDataBST.size();
 }
@@ -1,6 +1,13 @@
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "WeatherData.h"
+#include "Benchmark.h"
+#include "MetDataParser.h"
+#include "SelfTest.h"
 
 using namespace std;
 
@@ -13,6 +20,18 @@ private:
 public:
     Assignment2App() : weatherData(), dataLoaded(false) {}
 
+    // Also keep these columns of the data files, for correlating them
+    bool keepColumns(const vector<string>& names)
+    {
+        return weatherData.setExtraColumns(names);
+    }
+
+    // Keep the data in segment files under directory instead of in memory
+    bool useSegmentStore(const string& directory, size_t memoryBudget)
+    {
+        return weatherData.openSegmentStore(directory, memoryBudget);
+    }
+
     void run()
     {
         int choice;
@@ -72,6 +91,15 @@ private:
 
     void loadData()
     {
+        // Loading the same files again would count every record twice
+        if (dataLoaded)
+        {
+            cout << "Data already loaded. Checking the data files for new rows..." << endl;
+            long long added = weatherData.refreshFromFiles();
+            cout << added << " new record(s) added." << endl;
+            return;
+        }
+
         string filename;
         cout << "Enter the data source file name: ";
         cin >> filename;
@@ -111,9 +139,46 @@ private:
         }
 
         cout << "\nSample Pearson Correlation Coefficient for Month" << endl;
-        cout << "S_T: " << weatherData.calculateSPCC(month, "S_T") << endl;
-        cout << "S_R: " << weatherData.calculateSPCC(month, "S_R") << endl;
-        cout << "T_R: " << weatherData.calculateSPCC(month, "T_R") << endl;
+        // All three pairs from one matrix rather than three separate passes
+        Statistics::CoMomentMatrix matrix = weatherData.getCorrelationMatrix(
+            {MetDataParser::WIND_SPEED_HEADER, MetDataParser::TEMPERATURE_HEADER, MetDataParser::SOLAR_RADIATION_HEADER},
+            month);
+        cout << "S_T: " << matrix.correlation(0, 1) << endl;
+        cout << "S_R: " << matrix.correlation(0, 2) << endl;
+        cout << "T_R: " << matrix.correlation(1, 2) << endl;
+
+        const vector<string>& extraColumns = weatherData.getExtraColumns();
+        if (extraColumns.empty())
+        {
+            return;
+        }
+
+        // The columns kept with --columns, against each other and S, T and SR
+        vector<string> names = {MetDataParser::WIND_SPEED_HEADER, MetDataParser::TEMPERATURE_HEADER,
+                                MetDataParser::SOLAR_RADIATION_HEADER};
+        names.insert(names.end(), extraColumns.begin(), extraColumns.end());
+        matrix = weatherData.getCorrelationMatrix(names, month);
+
+        cout << "\nCorrelation matrix" << endl;
+        ios::fmtflags flags = cout.flags();
+        streamsize precision = cout.precision(4);
+        cout << fixed << setw(8) << "";
+        for (const string& name : names)
+        {
+            cout << setw(9) << name;
+        }
+        cout << endl;
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            cout << setw(8) << names[i];
+            for (size_t j = 0; j < names.size(); j++)
+            {
+                cout << setw(9) << matrix.correlation(i, j);
+            }
+            cout << endl;
+        }
+        cout.flags(flags);
+        cout.precision(precision);
     }
 
     void generateReport()
@@ -125,9 +190,16 @@ private:
         }
 
         int year;
-        cout << "Enter year for report: ";
+        cout << "Enter year for report (0 for every year): ";
         cin >> year;
 
+        if (year == 0)
+        {
+            // One pass over all the data, one WindTempSolar_<year>.csv per year
+            weatherData.generateMonthlyStatsForYears({}, "WindTempSolar_");
+            return;
+        }
+
         weatherData.generateMonthlyStats(year, "WindTempSolar.csv");
         cout << "Report generated: WindTempSolar.csv" << endl;
     }
@@ -143,6 +215,49 @@ private:
         cout << "\n=== Data Structure Information ===" << endl;
         cout << "Total records: " << weatherData.getTotalRecords() << endl;
 
+        cout << "Available years:";
+        for (int year : weatherData.getAvailableYears())
+        {
+            cout << " " << year;
+        }
+        cout << endl;
+
+        cout << "Partition scans for cached aggregates: " << weatherData.getAggregateScanCount() << endl;
+
+        // Every partition's sketch uses the default k, so they share one error bound
+        cout << "\nPercentiles by month, all years (approximate: rank within "
+             << Statistics::QuantileSketch().getRankError() * 100 << "%)" << endl;
+        const MeasuredField fields[] = {MeasuredField::WindSpeed, MeasuredField::Temperature,
+                                        MeasuredField::SolarRadiation};
+        const char* const fieldNames[] = {"S", "T", "SR"};
+        cout << setw(5) << "Month";
+        for (const char* name : fieldNames)
+        {
+            cout << setw(9) << string(name) + " p5" << setw(9) << string(name) + " p50" << setw(9) << string(name) + " p95";
+        }
+        cout << endl;
+        for (int month = 1; month <= 12; month++)
+        {
+            cout << setw(5) << month;
+            for (MeasuredField field : fields)
+            {
+                cout << setw(9) << weatherData.getMonthlyPercentile(month, field, 0.05)
+                     << setw(9) << weatherData.getMonthlyMedian(month, field)
+                     << setw(9) << weatherData.getMonthlyPercentile(month, field, 0.95);
+            }
+            cout << endl;
+        }
+
+        if (weatherData.isOutOfCore())
+        {
+            const SegmentStore& store = weatherData.getSegmentStore();
+            cout << "Segment store: " << store.getDirectory() << " ("
+                 << store.getPartitionCount() << " segments, "
+                 << store.getResidentSegments() << " mapped, "
+                 << store.getResidentBytes() / (1024.0 * 1024.0) << " MB of "
+                 << store.getMemoryBudget() / (1024.0 * 1024.0) << " MB budget)" << endl;
+        }
+
         // Demonstration of map usage
         Map<string, int> testMap;
         testMap.insert("test", 42);
@@ -153,12 +268,65 @@ private:
 
 
 
-int main()
+// Usage: program [--columns LIST] [--segments DIR] [--memory-mb N] | --self-test | --benchmark [ROWS]
+//   --columns LIST  also keep these comma-separated columns (e.g. RH,DP) and correlate them in option 3
+//   --segments DIR  keep the weather data in segment files under DIR (out-of-core)
+//   --memory-mb N   memory budget for mapped segments, default 256
+//   --self-test     run the self-tests instead of the menu; exit status 1 if any fails
+//   --benchmark     time loading and reports on ROWS generated readings (default 1000000)
+int main(int argc, char* argv[])
 {
     cout << "ICT283 Lab 11 Exercise" << endl;
     cout << "======================" << endl;
 
+    string segmentDirectory;
+    vector<string> extraColumns;
+    size_t memoryMegabytes = 256;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--segments") == 0 && i + 1 < argc)
+        {
+            segmentDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc)
+        {
+            string list = argv[++i];
+            for (size_t start = 0; start <= list.size();)
+            {
+                size_t comma = list.find(',', start);
+                size_t end = (comma == string::npos) ? list.size() : comma;
+                extraColumns.push_back(list.substr(start, end - start));
+                start = end + 1;
+            }
+        }
+        else if (strcmp(argv[i], "--memory-mb") == 0 && i + 1 < argc)
+        {
+            memoryMegabytes = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--self-test") == 0)
+        {
+            return SelfTest::runAll() ? 0 : 1;
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0)
+        {
+            long long rows = (i + 1 < argc) ? strtoll(argv[i + 1], nullptr, 10) : 0;
+            return Benchmark::runAll(rows > 0 ? rows : 1000000) ? 0 : 1;
+        }
+        else
+        {
+            cerr << "Warning: Ignoring unknown argument " << argv[i] << endl;
+        }
+    }
+
     Assignment2App app;
+    if (!extraColumns.empty() && !app.keepColumns(extraColumns))
+    {
+        return 1;
+    }
+    if (!segmentDirectory.empty() && !app.useSegmentStore(segmentDirectory, memoryMegabytes * 1024 * 1024))
+    {
+        return 1;
+    }
     app.run();
 
     return 0;